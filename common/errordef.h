@@ -20,6 +20,7 @@
 enum {
     ERR_INVALID_INPUT        = -1,
     ERR_FORWARD_TIMEOUT      = -2,
+    ERR_TASK_QUEUE_CLOSED    = -3,
 
     ERR_READ_CHECKPOINT      = -1000,
     ERR_CREATE_SESSION       = -1001,
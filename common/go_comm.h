@@ -47,8 +47,8 @@ const GoStoneColor WALL = 3;
 const GoStoneColor COLOR_UNKNOWN = -1;
 const char *const COLOR_STRING[] = { "Empty", "Black", "White", "Wall" };
 
-const GoCoordId DELTA_X[] = { 0, 1, 0, -1 };
-const GoCoordId DELTA_Y[] = { -1, 0, 1, 0 };
+constexpr GoCoordId DELTA_X[] = { 0, 1, 0, -1 };
+constexpr GoCoordId DELTA_Y[] = { -1, 0, 1, 0 };
 const GoSize DELTA_SIZE = sizeof(DELTA_X) / sizeof(*DELTA_X);
 
 const GoSize UINT64_BITS = sizeof(uint64_t) * 8;
@@ -102,34 +102,204 @@ extern std::string IdToStr(const GoCoordId id);
 extern GoCoordId StrToId(const std::string &str);
 
 
-extern void CreateGlobalVariables();
-
-extern void CreateHashWeights();
-
-extern void CreateNeighbourCache();
-
-extern void CreateQuickLog2Table();
-
-extern void CreateZobristHash();
-
 } // namespace GoFunction
 
 
-typedef std::pair<GoCoordId, GoCoordId> GoPosition;
-typedef std::pair<uint64_t, uint64_t> GoHashValuePair;
-
-extern GoHashValuePair g_hash_weight[GoComm::BORDER_SIZE][GoComm::BORDER_SIZE];
-const GoHashValuePair g_hash_unit(3, 7);
-extern uint64_t g_zobrist_board_hash_weight[4][GoComm::GOBOARD_SIZE];
-extern uint64_t g_zobrist_ko_hash_weight[GoComm::GOBOARD_SIZE];
-extern uint64_t g_zobrist_player_hash_weight[4];
-
-extern std::vector<GoPosition> g_neighbour_cache_by_coord[GoComm::BORDER_SIZE][GoComm::BORDER_SIZE];
-extern GoSize g_neighbour_size[GoComm::GOBOARD_SIZE];
-extern GoCoordId g_neighbour_cache_by_id[GoComm::GOBOARD_SIZE][GoComm::DELTA_SIZE + 1];
-extern GoCoordId g_log2_table[67];
-
-#define FOR_NEI(id, nb) for (GoCoordId *nb = g_neighbour_cache_by_id[(id)]; \
+// Tables below are computed at compile time, no initialization is needed before use.
+namespace GoTables {
+
+template<int... Is>
+struct IndexSeq {};
+
+template<class A, class B>
+struct ConcatIndexSeq;
+
+template<int... As, int... Bs>
+struct ConcatIndexSeq<IndexSeq<As...>, IndexSeq<Bs...>> {
+    typedef IndexSeq<As..., (sizeof...(As) + Bs)...> type;
+};
+
+// 0, 1, ..., N - 1, built in halves to keep template recursion shallow
+template<int N>
+struct MakeIndexSeq {
+    typedef typename ConcatIndexSeq<typename MakeIndexSeq<N / 2>::type,
+                                    typename MakeIndexSeq<N - N / 2>::type>::type type;
+};
+
+template<>
+struct MakeIndexSeq<0> { typedef IndexSeq<> type; };
+
+template<>
+struct MakeIndexSeq<1> { typedef IndexSeq<0> type; };
+
+// data[N] filled with F(0), F(1), ...
+template<class T, int N, T (*F)(int), class Seq = typename MakeIndexSeq<N>::type>
+struct Table;
+
+template<class T, int N, T (*F)(int), int... Is>
+struct Table<T, N, F, IndexSeq<Is...>> {
+    static constexpr T data[N] = { F(Is)... };
+};
+
+template<class T, int N, T (*F)(int), int... Is>
+constexpr T Table<T, N, F, IndexSeq<Is...>>::data[N];
+
+// data[R][C] filled with F(0), F(1), ... in row major order
+template<class T, int R, int C, T (*F)(int), class Seq = typename MakeIndexSeq<R * C>::type>
+struct Table2D;
+
+template<class T, int R, int C, T (*F)(int), int... Is>
+struct Table2D<T, R, C, F, IndexSeq<Is...>> {
+    static constexpr T data[R][C] = { F(Is)... };
+};
+
+template<class T, int R, int C, T (*F)(int), int... Is>
+constexpr T Table2D<T, R, C, F, IndexSeq<Is...>>::data[R][C];
+
+// neighbours on board of border size N
+template<int N>
+constexpr GoCoordId NeighbourInDirection(int id, int d) {
+    return 0 <= id / N + GoComm::DELTA_X[d] && id / N + GoComm::DELTA_X[d] < N
+        && 0 <= id % N + GoComm::DELTA_Y[d] && id % N + GoComm::DELTA_Y[d] < N
+        ? id + GoComm::DELTA_X[d] * N + GoComm::DELTA_Y[d] : GoComm::COORD_UNSET;
+}
+
+// k-th neighbour of id on board, from direction d on
+template<int N>
+constexpr GoCoordId NthNeighbour(int id, int k, int d = 0) {
+    return d == GoComm::DELTA_SIZE ? GoComm::COORD_UNSET
+         : GoComm::COORD_UNSET == NeighbourInDirection<N>(id, d) ? NthNeighbour<N>(id, k, d + 1)
+         : k == 0 ? NeighbourInDirection<N>(id, d) : NthNeighbour<N>(id, k - 1, d + 1);
+}
+
+template<int N>
+constexpr GoCoordId NeighbourCache(int i) {
+    return NthNeighbour<N>(i / (GoComm::DELTA_SIZE + 1), i % (GoComm::DELTA_SIZE + 1));
+}
+
+template<int N>
+constexpr GoSize CountNeighbours(int id, int k) {
+    return GoComm::COORD_UNSET == NthNeighbour<N>(id, k) ? k : CountNeighbours<N>(id, k + 1);
+}
+
+template<int N>
+constexpr GoSize NeighbourSize(int id) {
+    return CountNeighbours<N>(id, 0);
+}
+
+// i such that 2^i % 67 == v, -1 if none
+constexpr GoCoordId FindLog2(int v, int i, int pow2) {
+    return i == 64 ? -1 : pow2 == v ? i : FindLog2(v, i + 1, pow2 * 2 % 67);
+}
+
+constexpr GoCoordId QuickLog2(int v) {
+    return FindLog2(v, 0, 1);
+}
+
+// splitmix64 of i
+constexpr uint64_t Mix64Step3(uint64_t z) { return z ^ (z >> 31); }
+constexpr uint64_t Mix64Step2(uint64_t z) { return Mix64Step3((z ^ (z >> 27)) * 0x94d049bb133111ebULL); }
+constexpr uint64_t Mix64Step1(uint64_t z) { return Mix64Step2((z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL); }
+constexpr uint64_t ZobristRandom(int i) { return Mix64Step1(0xdeadbeafULL + (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ULL); }
+
+constexpr uint64_t ZobristBoard(int i) { return ZobristRandom(i); }
+constexpr uint64_t ZobristKo(int i) { return ZobristRandom(4 * GoComm::GOBOARD_SIZE + i); }
+constexpr uint64_t ZobristPlayer(int i) { return ZobristRandom(5 * GoComm::GOBOARD_SIZE + i); }
+
+} // namespace GoTables
+
+static constexpr const uint64_t (&g_zobrist_board_hash_weight)[4][GoComm::GOBOARD_SIZE] =
+    GoTables::Table2D<uint64_t, 4, GoComm::GOBOARD_SIZE, GoTables::ZobristBoard>::data;
+static constexpr const uint64_t (&g_zobrist_ko_hash_weight)[GoComm::GOBOARD_SIZE] =
+    GoTables::Table<uint64_t, GoComm::GOBOARD_SIZE, GoTables::ZobristKo>::data;
+static constexpr const uint64_t (&g_zobrist_player_hash_weight)[4] =
+    GoTables::Table<uint64_t, 4, GoTables::ZobristPlayer>::data;
+
+static constexpr const GoSize (&g_neighbour_size)[GoComm::GOBOARD_SIZE] =
+    GoTables::Table<GoSize, GoComm::GOBOARD_SIZE, GoTables::NeighbourSize<GoComm::BORDER_SIZE>>::data;
+static constexpr const GoCoordId (&g_neighbour_cache_by_id)[GoComm::GOBOARD_SIZE][GoComm::DELTA_SIZE + 1] =
+    GoTables::Table2D<GoCoordId, GoComm::GOBOARD_SIZE, GoComm::DELTA_SIZE + 1, GoTables::NeighbourCache<GoComm::BORDER_SIZE>>::data;
+static constexpr const GoCoordId (&g_log2_table)[67] =
+    GoTables::Table<GoCoordId, 67, GoTables::QuickLog2>::data;
+
+
+// Sizes, coordinates and neighbours of board of border size N.
+// GoComm and GoFunction are the ones of 19x19 board, the largest one, buffers sized by GoComm fit any board.
+template<int N>
+struct GoBoard {
+    static_assert(N > 1 && N <= GoComm::BORDER_SIZE, "unsupported board size");
+
+    static constexpr GoCoordId BORDER_SIZE = N;
+    static constexpr GoCoordId GOBOARD_SIZE = N * N;
+    static constexpr GoSize BOARD_STATE_SIZE = (N * N + GoComm::UINT64_BITS - 1) / GoComm::UINT64_BITS;
+
+    static bool InBoard(const GoCoordId id) {
+        return 0 <= id && id < GOBOARD_SIZE;
+    }
+
+    static bool InBoard(const GoCoordId x, const GoCoordId y) {
+        return 0 <= x && x < BORDER_SIZE && 0 <= y && y < BORDER_SIZE;
+    }
+
+    static void IdToCoord(const GoCoordId id, GoCoordId &x, GoCoordId &y) {
+        if (GoComm::COORD_PASS == id || GoComm::COORD_RESIGN == id) {
+            x = y = id;
+        } else if (!InBoard(id)) {
+            x = y = GoComm::COORD_UNSET;
+        } else {
+            x = id / BORDER_SIZE;
+            y = id % BORDER_SIZE;
+        }
+    }
+
+    static GoCoordId CoordToId(const GoCoordId x, const GoCoordId y) {
+        if ((GoComm::COORD_PASS == x || GoComm::COORD_RESIGN == x) && x == y) {
+            return x;
+        }
+        return InBoard(x, y) ? x * BORDER_SIZE + y : GoComm::COORD_UNSET;
+    }
+
+    static void StrToCoord(const std::string &str, GoCoordId &x, GoCoordId &y) {
+        x = str[0] - 'a';
+        y = str[1] - 'a';
+        if (str == "zz") {
+            x = y = GoComm::COORD_PASS;
+        } else if (!InBoard(x, y)) {
+            x = y = GoComm::COORD_UNSET;
+        }
+    }
+
+    static std::string CoordToStr(const GoCoordId x, const GoCoordId y) {
+        return InBoard(x, y) ? std::string{char(x + 'a'), char(y + 'a')} : std::string("zz");
+    }
+
+    static std::string IdToStr(const GoCoordId id) {
+        GoCoordId x, y;
+        IdToCoord(id, x, y);
+        return CoordToStr(x, y);
+    }
+
+    static GoCoordId StrToId(const std::string &str) {
+        GoCoordId x, y;
+        StrToCoord(str, x, y);
+        return CoordToId(x, y);
+    }
+
+    // neighbours of id, ended by COORD_UNSET
+    static const GoCoordId *Neighbours(const GoCoordId id) {
+        return GoTables::Table2D<GoCoordId, GOBOARD_SIZE, GoComm::DELTA_SIZE + 1, GoTables::NeighbourCache<N>>::data[id];
+    }
+};
+
+template<int N> constexpr GoCoordId GoBoard<N>::BORDER_SIZE;
+template<int N> constexpr GoCoordId GoBoard<N>::GOBOARD_SIZE;
+template<int N> constexpr GoSize GoBoard<N>::BOARD_STATE_SIZE;
+
+// board sizes of GoState and MCTSEngine instances
+#define FOR_EACH_BOARD_SIZE(F) F(9) F(13) F(19)
+
+// for code on board of border size N, N is taken from where the macros are used
+#define FOR_NEI(id, nb) for (const GoCoordId *nb = GoBoard<N>::Neighbours(id); \
                              GoComm::COORD_UNSET != *nb; ++nb)
-#define FOR_EACHCOORD(id) for (GoCoordId id = 0; id < GoComm::GOBOARD_SIZE; ++id)
+#define FOR_EACHCOORD(id) for (GoCoordId id = 0; id < GoBoard<N>::GOBOARD_SIZE; ++id)
 #define FOR_EACHBLOCK(id) for (GoBlockId id = 0; id < GoComm::MAX_BLOCK_SIZE; ++id)
@@ -18,6 +18,7 @@
 #include "go_state.h"
 
 #include <algorithm>
+#include <cstddef>
 
 #define x first
 #define y second
@@ -27,71 +28,152 @@ using namespace GoComm;
 using namespace GoFunction;
 using namespace GoFeature;
 
-// int popcount64(unsigned long long x) {
-//     x = (x & 0x5555555555555555ULL) + ((x >> 1) & 0x5555555555555555ULL);
-//     x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
-//     x = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
-//     return (x * 0x0101010101010101ULL) >> 56;
-// }
+const int HISTORY_SIZE = SIZE_HISTORYEACHSIDE / 2;
 
-GoState::GoState(bool positional_superko) {
-    CreateGlobalVariables();
+// offset of a member declared right after one at offset off of size size
+static constexpr size_t NextMemberOffset(size_t off, size_t size, size_t align) {
+    return (off + size + align - 1) / align * align;
+}
 
-    positional_superko_ = positional_superko;
+// b is declared right after a, nothing may come in between, or Move journals wrong bytes
+#define STATIC_ASSERT_ADJACENT(a, b) \
+    static_assert(offsetof(GoStateT, b) == NextMemberOffset(offsetof(GoStateT, a), sizeof(a), alignof(decltype(b))), \
+                  #b " must be declared right after " #a)
 
-    FOR_EACHCOORD(i) {
-        stones_[i].self_id = i;
+
+// bits of word w that are on the board
+template<int N>
+static inline uint64_t BoardMask(int w) {
+    return w == GoBoard<N>::BOARD_STATE_SIZE - 1 && GoBoard<N>::GOBOARD_SIZE % UINT64_BITS
+        ? (1ULL << (GoBoard<N>::GOBOARD_SIZE % UINT64_BITS)) - 1 : ~0ULL;
+}
+
+
+bool GoSuperkoHistory::ContainsOwn(uint64_t hash) const {
+    if (hash == 0) {
+        return has_zero_;
+    }
+    if (slots_.empty()) {
+        return false;
+    }
+    for (size_t i = Slot(hash); slots_[i] != 0; i = (i + 1) & (slots_.size() - 1)) {
+        if (slots_[i] == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool GoSuperkoHistory::Insert(uint64_t hash) {
+    if (Contains(hash)) {
+        return false;
+    }
+    if (hash == 0) {
+        has_zero_ = true;
+        return true;
+    }
+    if ((size_ + 1) * 2 > slots_.size()) {
+        // keep load factor under 1/2
+        std::vector<uint64_t> old_slots(std::max<size_t>(slots_.size() * 2, 64), 0);
+        old_slots.swap(slots_);
+        size_ = 0;
+        for (uint64_t h: old_slots) {
+            if (h != 0) {
+                Insert(h);
+            }
+        }
+    }
+    size_t i = Slot(hash);
+    while (slots_[i] != 0) {
+        i = (i + 1) & (slots_.size() - 1);
     }
-    FOR_EACHBLOCK(i) {
-        block_pool_[i].in_use = false;
-        block_pool_[i].self_id = i;
-        block_pool_[i].stones = stones_;
+    slots_[i] = hash;
+    ++size_;
+    return true;
+}
+
+
+void GoSuperkoHistory::Erase(uint64_t hash) {
+    if (hash == 0) {
+        has_zero_ = false;
+        return;
     }
-    while (!recycled_blocks_.empty()) {
-        recycled_blocks_.pop();
+    if (slots_.empty()) {
+        return;
     }
-    // CHECK(recycled_blocks_.empty()) << "block reuse util initialize fail";
+    size_t mask = slots_.size() - 1;
+    size_t i = Slot(hash);
+    while (slots_[i] != hash) {
+        if (slots_[i] == 0) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    // shift later entries of the probe chain back, so that no lookup stops early at the hole
+    for (size_t j = (i + 1) & mask; slots_[j] != 0; j = (j + 1) & mask) {
+        size_t home = Slot(slots_[j]);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots_[i] = slots_[j];
+            i = j;
+        }
+    }
+    slots_[i] = 0;
+    --size_;
+}
 
-    feature_history_list_.clear();
+
+void GoSuperkoHistory::Reset(const GoSuperkoHistory *base) {
+    base_ = base;
+    if (size_ > 0) {
+        std::fill(slots_.begin(), slots_.end(), 0);
+    }
+    size_ = 0;
+    has_zero_ = false;
+}
+
+
+template<int N>
+GoStateT<N>::GoStateT(bool positional_superko) {
+    positional_superko_ = positional_superko;
+    superko_history_ = nullptr;
+
+    FOR_EACHCOORD(i) {
+        block_root_[i] = COORD_UNSET;
+        next_stone_[i] = i;
+    }
     memset(board_state_, 0, sizeof(board_state_));
-    memset(visited_positions_, 0, sizeof(visited_positions_));
-    memset(legal_move_map_, 1, sizeof(legal_move_map_));
+    memset(stone_count_, 0, sizeof(stone_count_));
     memset(liberty_count_, 0, sizeof(liberty_count_));
-    memset(move_count_, 0, sizeof(move_count_));
-    timestamp_ = SIZE_NONE;
-    block_in_use_ = SIZE_NONE;
+    memset(surrounded_planes_, 0, sizeof(surrounded_planes_));
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        legal_planes_[w] = BoardMask<N>(w);
+    }
+    memset(stone_planes_, 0, sizeof(stone_planes_));
+    memset(history_planes_, 0, sizeof(history_planes_));
+    history_count_ = 0;     // history_hash_values_ are read only up to history_count_
     current_player_ = BLACK;
     ko_position_ = COORD_UNSET;
     last_position_ = COORD_UNSET;
     is_double_pass_ = false;
-    board_hash_states_.clear();
     zobrist_hash_value_ = 0;
-    // cerr << __func__ << hex << int(g_vtNeighbourCache) << endl;
 }
 
 
-GoState::GoState(const GoState &gms) : GoState() {
-    CopyFrom(gms);
-}
-
-
-GoState::~GoState() {
-}
-
-
-GoSize GoState::CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, bool *vis) const {
+template<int N>
+GoSize GoStateT<N>::CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, bool *vis) const {
     // using stack instead of queue for speed up
-    stack<GoCoordId> q;
+    GoCoordId q[GOBOARD_SIZE];
+    int top = 0;
     GoSize cnt = SIZE_NONE;
     GoStoneColor colorSet = EMPTY;
     GoCoordId nxy;
 
     vis[xy] = true;
-    q.push(xy);
+    q[top++] = xy;
     ++cnt;
-    while (!q.empty()) {
-        nxy = q.top();
-        q.pop();
+    while (top > 0) {
+        nxy = q[--top];
         FOR_NEI(nxy, np) {
             if (vis[*np]) {
                 continue;
@@ -99,7 +181,7 @@ GoSize GoState::CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, b
             colorSet |= board_state_[*np];
             if (EMPTY == board_state_[*np]) {
                 vis[*np] = true;
-                q.push(*np);
+                q[top++] = *np;
                 ++cnt;
             }
         }
@@ -109,7 +191,84 @@ GoSize GoState::CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, b
 }
 
 
-GoSize GoState::CalcScore(GoSize &black, GoSize &white, GoSize &empty) const {
+// points whose left (id - 1) or right (id + 1) neighbour is in the same row
+template<int N>
+struct RowMasks {
+    uint64_t has_left[GoBoard<N>::BOARD_STATE_SIZE];
+    uint64_t has_right[GoBoard<N>::BOARD_STATE_SIZE];
+
+    RowMasks() {
+        memset(this, 0, sizeof(*this));
+        for (int id = 0; id < GoBoard<N>::GOBOARD_SIZE; ++id) {
+            if (id % N != 0) {
+                has_left[id >> 6] |= 1ULL << (id & 63);
+            }
+            if (id % N != N - 1) {
+                has_right[id >> 6] |= 1ULL << (id & 63);
+            }
+        }
+    }
+
+    static const RowMasks instance;
+};
+
+template<int N>
+const RowMasks<N> RowMasks<N>::instance;
+
+
+// grow reach by one step through empty points at a time, until it stops growing
+template<int N>
+static void FloodFill(uint64_t *reach, const uint64_t *empty) {
+    const GoSize size = GoBoard<N>::BOARD_STATE_SIZE;
+    const RowMasks<N> &row_masks = RowMasks<N>::instance;
+    uint64_t changed;
+    do {
+        uint64_t grown[size];
+        for (GoSize w = 0; w < size; ++w) {
+            uint64_t prev = w > 0 ? reach[w - 1] : 0;
+            uint64_t next = w + 1 < size ? reach[w + 1] : 0;
+            uint64_t from_left = (reach[w] << 1 | prev >> 63) & row_masks.has_left[w];
+            uint64_t from_right = (reach[w] >> 1 | next << 63) & row_masks.has_right[w];
+            uint64_t from_up = reach[w] << N | prev >> (UINT64_BITS - N);
+            uint64_t from_down = reach[w] >> N | next << (UINT64_BITS - N);
+            grown[w] = (from_left | from_right | from_up | from_down) & empty[w];
+        }
+        changed = 0;
+        for (GoSize w = 0; w < size; ++w) {
+            changed |= grown[w] & ~reach[w];
+            reach[w] |= grown[w];
+        }
+    } while (changed);
+}
+
+
+template<int N>
+GoSize GoStateT<N>::CalcScore(GoSize &black, GoSize &white, GoSize &empty) const {
+    // an empty region is area of a color if it reaches stones of that color only
+    uint64_t empty_plane[BOARD_STATE_SIZE];
+    uint64_t reach_black[BOARD_STATE_SIZE];
+    uint64_t reach_white[BOARD_STATE_SIZE];
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        empty_plane[w] = ~(stone_planes_[BLACK - 1][w] | stone_planes_[WHITE - 1][w]) & BoardMask<N>(w);
+        reach_black[w] = stone_planes_[BLACK - 1][w];
+        reach_white[w] = stone_planes_[WHITE - 1][w];
+    }
+    FloodFill<N>(reach_black, empty_plane);
+    FloodFill<N>(reach_white, empty_plane);
+
+    black = white = 0;
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        black += __builtin_popcountll(reach_black[w] & ~reach_white[w]);
+        white += __builtin_popcountll(reach_white[w] & ~reach_black[w]);
+    }
+    empty = GOBOARD_SIZE - black - white;
+
+    return black - white;
+}
+
+
+template<int N>
+GoSize GoStateT<N>::CalcScoreScalar(GoSize &black, GoSize &white, GoSize &empty) const {
     CalcScoreWithColor(black, BLACK);
     CalcScoreWithColor(white, WHITE);
     empty = GOBOARD_SIZE - black - white;
@@ -118,7 +277,8 @@ GoSize GoState::CalcScore(GoSize &black, GoSize &white, GoSize &empty) const {
 }
 
 
-void GoState::CalcScoreWithColor(GoSize &cnt, const GoStoneColor color) const {
+template<int N>
+void GoStateT<N>::CalcScoreWithColor(GoSize &cnt, const GoStoneColor color) const {
     bool vis[GOBOARD_SIZE];
 
     cnt = SIZE_NONE;
@@ -136,108 +296,232 @@ void GoState::CalcScoreWithColor(GoSize &cnt, const GoStoneColor color) const {
 }
 
 
-GoStoneColor GoState::GetWinner(GoSize &score) const {
+template<int N>
+GoStoneColor GoStateT<N>::GetWinner(GoSize &score) const {
     GoSize black, white, empty;
     score = CalcScore(black, white, empty);
     return score > 7.5 ? BLACK : WHITE;
 }
 
 
-GoStoneColor GoState::GetWinner() const {
+template<int N>
+GoStoneColor GoStateT<N>::GetWinner() const {
     GoSize score;
     return GetWinner(score);
 }
 
 
-void GoState::CopyFrom(const GoState &src) {
-    *this = src;
-    FixBlockInfo();
+template<int N>
+bool GoStateT<N>::IsMovable() const {
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        if (legal_planes_[w]) {
+            return true;
+        }
+    }
+    return false;
 }
 
 
-GoCoordId GoState::FindCoord(const GoCoordId id) {
-    if (stones_[id].parent_id == stones_[id].self_id) {
-        return stones_[id].self_id;
-    }
-    return stones_[id].parent_id = FindCoord(stones_[id].parent_id);
+template<int N>
+void GoStateT<N>::GetLastMove(GoCoordId &x, GoCoordId &y) {
+    Board::IdToCoord(last_position_, x, y);
 }
 
 
-void GoState::FixBlockInfo() {
-    FOR_EACHBLOCK(i) {
-        block_pool_[i].stones = stones_;
+template<int N>
+int GoStateT<N>::GetNeighbourBlocks(const GoCoordId id, GoCoordId *roots) const {
+    int n = 0;
+    FOR_NEI(id, nb) {
+        if (EMPTY == board_state_[*nb]) {
+            continue;
+        }
+        GoCoordId root = block_root_[*nb];
+        if (find(roots, roots + n, root) == roots + n) {
+            roots[n++] = root;
+        }
     }
+    return n;
 }
 
 
-bool GoState::IsMovable() const {
-    FOR_EACHCOORD(i) {
-        if (legal_move_map_[i]) {
-            return true;
+template<int N>
+void GoStateT<N>::PlaceStone(const GoCoordId to, GoJournal *journal) {
+    GoCoordId roots[DELTA_SIZE];
+    int n = GetNeighbourBlocks(to, roots);
+    // blocks are merged into to or one of roots, which are all saved here
+    SavePoint(journal, to);
+    for (int i = 0; i < n; ++i) {
+        SavePoint(journal, roots[i]);
+    }
+
+    board_state_[to] = Self();
+    block_root_[to] = to;
+    next_stone_[to] = to;
+    stone_count_[to] = 1;
+    liberty_count_[to] = 0;
+    FOR_NEI(to, nb) {
+        if (EMPTY == board_state_[*nb]) {
+            ++liberty_count_[to];
+        }
+    }
+    stone_planes_[Self() - 1][to >> 6] |= 1ULL << (to & 63);
+    surrounded_planes_[to >> 6] &= ~(1ULL << (to & 63));
+    FOR_NEI(to, nb) {
+        if (EMPTY == board_state_[*nb]) {
+            UpdateSurrounded(*nb);
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        --liberty_count_[roots[i]];
+    }
+
+    GoCoordId ko = COORD_UNSET;
+    for (int i = 0; i < n; ++i) {
+        if (Opponent() == board_state_[roots[i]] && 0 == liberty_count_[roots[i]]) {
+            if (1 == stone_count_[roots[i]]) {
+                ko = roots[i];
+            }
+            RemoveBlock(roots[i], journal);
         }
     }
-    return false;
-}
 
+    for (int i = 0; i < n; ++i) {
+        if (Self() == board_state_[roots[i]]) {
+            MergeBlocks(block_root_[to], block_root_[roots[i]], journal);
+        }
+    }
 
-GoBlockId GoState::GetBlockIdByCoord(const GoCoordId id) {
-    if (EMPTY == board_state_[id]) {
-        return BLOCK_UNSET;
+    GoCoordId root = block_root_[to];
+    if (COORD_UNSET != ko && 1 == stone_count_[root] && 1 == liberty_count_[root]) {
+        ko_position_ = ko;
     }
-    return stones_[FindCoord(id)].block_id;
 }
 
 
-void GoState::GetLastMove(GoCoordId &x, GoCoordId &y) {
-    IdToCoord(last_position_, x, y);
+template<int N>
+GoSize GoStateT<N>::RemoveBlock(const GoCoordId root, GoJournal *journal) {
+    GoStoneColor color = board_state_[root];
+    GoSize count = stone_count_[root];
+
+    GoCoordId id = root;
+    do {
+        SavePoint(journal, id);
+        board_state_[id] = EMPTY;
+        block_root_[id] = COORD_UNSET;
+        stone_planes_[color - 1][id >> 6] &= ~(1ULL << (id & 63));
+        zobrist_hash_value_ ^= g_zobrist_board_hash_weight[color][id];
+        id = next_stone_[id];
+    } while (id != root);
+
+    // each removed stone becomes a liberty of blocks around it, and an empty neighbour of points around it
+    do {
+        GoCoordId roots[DELTA_SIZE];
+        int n = GetNeighbourBlocks(id, roots);
+        for (int i = 0; i < n; ++i) {
+            SavePoint(journal, roots[i]);
+            ++liberty_count_[roots[i]];
+        }
+        UpdateSurrounded(id);
+        FOR_NEI(id, nb) {
+            surrounded_planes_[*nb >> 6] &= ~(1ULL << (*nb & 63));
+        }
+        GoCoordId next = next_stone_[id];
+        next_stone_[id] = id;
+        id = next;
+    } while (id != root);
+
+    return count;
 }
 
 
-void GoState::GetNeighbourBlocks(GoBlock &blk, const GoCoordId to, GoBlockId *nbId) {
-    nbId[0] = 0;
-    blk.SetStoneState(to);
-    FOR_NEI(to, nb) {
-        blk.SetVirtLiberty(*nb);
+template<int N>
+void GoStateT<N>::UpdateSurrounded(const GoCoordId id) {
+    bool surrounded = EMPTY == board_state_[id];
+    FOR_NEI(id, nb) {
         if (EMPTY == board_state_[*nb]) {
-            blk.SetLiberty(*nb);
-        } else {
-            nbId[++nbId[0]] = GetBlockIdByCoord(*nb);
+            surrounded = false;
+            break;
         }
     }
-    sort(nbId + 1, nbId + nbId[0] + 1);
-    nbId[0] = unique(nbId + 1, nbId + nbId[0] + 1) - nbId - 1;
+    if (surrounded) {
+        surrounded_planes_[id >> 6] |= 1ULL << (id & 63);
+    } else {
+        surrounded_planes_[id >> 6] &= ~(1ULL << (id & 63));
+    }
 }
 
 
-void GoState::GetNewBlock(GoCoordId &id) {
-    id = BLOCK_UNSET;
-    if (!recycled_blocks_.empty()) {
-        id = recycled_blocks_.top();
-        recycled_blocks_.pop();
-    } else {
-        id = block_in_use_++;
-        // CHECK(block_in_use_ < MAX_BLOCK_SIZE) << "max-block-size not enough???";
+template<int N>
+void GoStateT<N>::MergeBlocks(GoCoordId a, GoCoordId b, GoJournal *journal) {
+    if (stone_count_[a] < stone_count_[b]) {
+        swap(a, b);
     }
-    block_pool_[id].Reset();
+    // liberties of b not shared with a, stones relabeled already count as a
+    GoCoordId id = b;
+    do {
+        FOR_NEI(id, nb) {
+            if (EMPTY != board_state_[*nb]) {
+                continue;
+            }
+            bool shared = false;
+            FOR_NEI(*nb, nnb) {
+                if (a == block_root_[*nnb]) {
+                    shared = true;
+                    break;
+                }
+            }
+            if (!shared) {
+                ++liberty_count_[a];
+            }
+        }
+        SavePoint(journal, id);
+        block_root_[id] = a;
+        id = next_stone_[id];
+    } while (id != b);
+
+    stone_count_[a] += stone_count_[b];
+    swap(next_stone_[a], next_stone_[b]);
 }
 
 
-vector<bool> GoState::GetFeature() const {
-    vector<bool> feature(GOBOARD_SIZE * (SIZE_HISTORYEACHSIDE + 1), 0);
-    // because push black into history first,
-    // if next player is black,
-    // we should get planes swap of each two planes
-    int reverse_plane = int(Self() == BLACK);
+template<int N>
+const uint64_t *GoStateT<N>::GetHistoryPlane(int i) const {
+    // planes of self and opponent alternately, from the latest position,
+    // positions before the game are never written so they are empty boards
+    int slot = (history_count_ + HISTORY_SIZE - 1 - i / 2) % HISTORY_SIZE;
+    GoStoneColor color = i % 2 == 0 ? Self() : Opponent();
+    return history_planes_[slot][color - 1];
+}
 
-    for (GoSize i = 0; i < SIZE_HISTORYEACHSIDE && i < feature_history_list_.size(); ++i) {
-        const string &feature_str = *(feature_history_list_.rbegin() + (i ^ reverse_plane));
-        for (int j = 0, k = i; j < GOBOARD_SIZE; ++j, k += 17) {
-            feature[k] = feature_str[j] - '0';
-        }
+
+template<int N>
+void GoStateT<N>::GetFeaturePlanes(uint64_t planes[][GoComm::BOARD_STATE_SIZE]) const {
+    for (GoSize i = 0; i < SIZE_HISTORYEACHSIDE; ++i) {
+        memcpy(planes[STARTPOS_HISTORYEACHSIDE + i], GetHistoryPlane(i), sizeof(legal_planes_));
     }
-    if (Self() == BLACK) {
-        for (int j = 0, k = SIZE_HISTORYEACHSIDE; j < GOBOARD_SIZE; ++j, k += 17) {
-            feature[k] = 1;
+    uint64_t *color_plane = planes[STARTPOS_PLAYERCOLOR];
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        color_plane[w] = Self() == BLACK ? BoardMask<N>(w) : 0;
+    }
+    for (GoSize i = 0; BOARD_STATE_SIZE < GoComm::BOARD_STATE_SIZE && i < FEATURE_COUNT; ++i) {
+        memset(planes[i] + BOARD_STATE_SIZE, 0, sizeof(planes[0]) - sizeof(legal_planes_));
+    }
+}
+
+
+template<int N>
+vector<bool> GoStateT<N>::GetFeature() const {
+    uint64_t planes[FEATURE_COUNT][GoComm::BOARD_STATE_SIZE];
+    GetFeaturePlanes(planes);
+
+    // only set bits are visited, features are interleaved as [point][plane]
+    vector<bool> feature(GOBOARD_SIZE * FEATURE_COUNT, 0);
+    for (GoSize i = 0; i < FEATURE_COUNT; ++i) {
+        for (GoSize j = 0; j < BOARD_STATE_SIZE; ++j) {
+            for (uint64_t bits = planes[i][j]; bits; bits ^= Lowbit(bits)) {
+                feature[((j << 6) + __builtin_ctzll(bits)) * FEATURE_COUNT + i] = 1;
+            }
         }
     }
 
@@ -245,23 +529,22 @@ vector<bool> GoState::GetFeature() const {
 }
 
 
-const string GoState::GetFeatureString() const {
-    string result_string;
-    // because push black into history first,
-    // if next player is black,
-    // we should get planes swap of each two planes
-    int reverse_plane = 0;
+template<int N>
+static string PlaneToString(const uint64_t *plane) {
+    string result_string(GoBoard<N>::GOBOARD_SIZE, '0');
+    FOR_EACHCOORD(j) {
+        result_string[j] += plane[j >> 6] >> (j & 63) & 1;
+    }
+    return result_string;
+}
+
 
-    reverse_plane = int(Self() == BLACK);
-    // CHECK(feature_history_list_.size() % 2 == 0)
-    //     << "feature_history_list_ size " << feature_history_list_.size() << " not legal";
+template<int N>
+const string GoStateT<N>::GetFeatureString() const {
+    string result_string;
 
     for (GoSize i = 0; i < SIZE_HISTORYEACHSIDE; ++i) {
-        if (i < feature_history_list_.size()) {
-            result_string += *(feature_history_list_.rbegin() + (i ^ reverse_plane));
-        } else {
-            result_string += string(GOBOARD_SIZE, '0');
-        }
+        result_string += PlaneToString<N>(GetHistoryPlane(i));
     }
     result_string += string(GOBOARD_SIZE, '0' + (Self() == BLACK));
 
@@ -269,206 +552,159 @@ const string GoState::GetFeatureString() const {
 }
 
 
-const string GoState::GetLastFeaturePlane() const {
-    return *(feature_history_list_.rbegin() + 1) + *feature_history_list_.rbegin();
+template<int N>
+const string GoStateT<N>::GetLastFeaturePlane() const {
+    int slot = (history_count_ + HISTORY_SIZE - 1) % HISTORY_SIZE;
+    return PlaneToString<N>(history_planes_[slot][BLACK - 1]) + PlaneToString<N>(history_planes_[slot][WHITE - 1]);
 }
 
 
-void GoState::GetSensibleMove() {
+template<int N>
+void GoStateT<N>::GetSensibleMove() {
     // Add new feature plane
-    string plane;
-    // black
-    {
-        plane = "";
-        FOR_EACHCOORD(id) {
-            if (board_state_[id] == BLACK) {
-                plane += "1";
-            } else {
-                plane += "0";
+    int slot = history_count_ % HISTORY_SIZE;
+    memcpy(history_planes_[slot], stone_planes_, sizeof(stone_planes_));
+    history_hash_values_[slot] = zobrist_hash_value_;
+    ++history_count_;
+
+    // empty points with an empty neighbour are legal, other empty points are checked one by one,
+    // surrounded_planes_ is kept up to date by PlaceStone and RemoveBlock
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        legal_planes_[w] = ~(stone_planes_[0][w] | stone_planes_[1][w] | surrounded_planes_[w]) & BoardMask<N>(w);
+    }
+    for (GoSize w = 0; w < BOARD_STATE_SIZE; ++w) {
+        for (uint64_t bits = surrounded_planes_[w]; bits; bits ^= Lowbit(bits)) {
+            GoCoordId i = (w << 6) + __builtin_ctzll(bits);
+            // not suicide if it captures, or joins a block with other liberties
+            bool alive = false;
+            FOR_NEI(i, nb) {
+                GoSize libCnt = liberty_count_[block_root_[*nb]];
+                if (Self() == board_state_[*nb] ? libCnt > 1 : libCnt == 1) {
+                    alive = true;
+                    break;
+                }
             }
-        }
-        feature_history_list_.push_back(plane);
-    }
-    // white
-    {
-        plane = "";
-        FOR_EACHCOORD(id) {
-            if (board_state_[id] == WHITE) {
-                plane += "1";
-            } else {
-                plane += "0";
+            // check board state duplicate
+            if (alive && !(positional_superko_ && superko_history_ && superko_history_->Contains(GetNewHashValue(i)))) {
+                legal_planes_[w] |= Lowbit(bits);
             }
         }
-        feature_history_list_.push_back(plane);
     }
-
-    GoBlockId blkId;
-    GoBlockId tmp[2][DELTA_SIZE + 1];
-    GoSize libCnt;
-
-    memset(legal_move_map_, 0, sizeof(legal_move_map_));
-    GetNewBlock(blkId);
-
-    GoBlock &blk = block_pool_[blkId];
-
-    FOR_EACHCOORD(i) {
-        if (EMPTY != board_state_[i]) {
-            continue;
-        }
-        if (ko_position_ == i) {
-            continue;
-        }
-        libCnt = 0;
-        FOR_NEI(i, nb) {
-            if (EMPTY == board_state_[*nb]) {
-                ++libCnt;
-                break;
-            }
-        }
-        legal_move_map_[i] = true;
-        if (libCnt > 0) {
-            continue;
-        }
-        TryMove(blk, i, tmp[0], tmp[1]);
-        blk.CountLiberty();
-        if (blk.liberty <= 0) {
-            legal_move_map_[i] = false;
-            continue;
-        }
-        // check board state duplicate
-        if (positional_superko_) {
-            uint64_t new_zobrist_hash_value = zobrist_hash_value_;
-
-            new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Self()];
-            new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Opponent()];
-            new_zobrist_hash_value ^= g_zobrist_board_hash_weight[Self()][i];
-
-            GoBlockId *dieId = tmp[1];
-
-            for (GoBlockId j = 1; j <= dieId[0]; ++j) {
-                FOR_BLOCKSTONE(tid, block_pool_[dieId[j]], {
-                    new_zobrist_hash_value ^= g_zobrist_board_hash_weight[Opponent()][tid];
-                });
-            }
-
-            if (board_hash_states_.find(new_zobrist_hash_value) != board_hash_states_.end()) {
-                legal_move_map_[i] = false;
-            }
-        }
+    if (COORD_UNSET != ko_position_) {
+        legal_planes_[ko_position_ >> 6] &= ~(1ULL << (ko_position_ & 63));
     }
-    RecycleBlock(blkId);
 }
 
 
-int GoState::Move(const GoCoordId to) {
+template<int N>
+int GoStateT<N>::Play(const GoCoordId to, GoJournal *journal) {
     if (!IsLegal(to)) {
         return -1;
     }
 
-    ++timestamp_;
     is_double_pass_ = IsPass(last_position_) && IsPass(to);
     last_position_ = to;
     ko_position_ = COORD_UNSET;
 
     // update zobrist hash board state
-    {
-        zobrist_hash_value_ ^= g_zobrist_player_hash_weight[Self()];
-        zobrist_hash_value_ ^= g_zobrist_player_hash_weight[Opponent()];
-        if (!IsPass(to)) {
-            zobrist_hash_value_ ^= g_zobrist_board_hash_weight[Self()][to];
-        }
+    zobrist_hash_value_ ^= g_zobrist_player_hash_weight[Self()];
+    zobrist_hash_value_ ^= g_zobrist_player_hash_weight[Opponent()];
+    if (!IsPass(to)) {
+        zobrist_hash_value_ ^= g_zobrist_board_hash_weight[Self()][to];
+        PlaceStone(to, journal);
     }
 
-    if (IsPass(to)) {
-        HandOff();
-        GetSensibleMove();
-
-        if (positional_superko_) {
-            board_hash_states_.insert(zobrist_hash_value_);
-        }
-
-        return 0;
-    }
-    GoBlockId blkId, nbId[DELTA_SIZE + 1], dieId[DELTA_SIZE + 1];
-    GoSize cnt;
-    GetNewBlock(blkId);
-    GoBlock &newBlk = block_pool_[blkId];
-
-    if ((cnt = TryMove(newBlk, to, nbId, dieId)) < 0) {
-        return -2;
-    }
-    stones_[to].Reset(blkId);
-    newBlk.in_use = true;
-    newBlk.head = newBlk.tail = to;
-    for (GoBlockId i = 1; i <= nbId[0]; ++i) {
-        GoBlock &blk = block_pool_[nbId[i]];
+    HandOff();
+    GetSensibleMove();
 
-        visited_positions_[nbId[i]] = timestamp_;
-        blk.ResetLiberty(to);
-        if (Self() == blk.color) {
-            newBlk.MergeBlocks(blk);
-            RecycleBlock(nbId[i]);
-        }
+    if (positional_superko_ && superko_history_ && superko_history_->Insert(zobrist_hash_value_) && journal) {
+        journal->Push(GoJournal::INSERT_HASH, superko_history_, zobrist_hash_value_);
     }
-    visited_positions_[blkId] = timestamp_;
 
-    for (GoBlockId i = 1; i <= dieId[0]; ++i) {
-        if (1 == block_pool_[dieId[i]].stone_count && 1 == newBlk.stone_count && 1 == newBlk.CountLiberty()) {
-            ko_position_ = block_pool_[dieId[i]].head;
-        }
-        FOR_BLOCKSTONE(tid, block_pool_[dieId[i]], {
-            FOR_NEI(tid, nb) {
-                if (Self() == board_state_[*nb]) {
-                    GoBlockId bid = GetBlockIdByCoord(*nb);
+    return 0;
+}
 
-                    visited_positions_[bid] = timestamp_;
-                    block_pool_[bid].SetLiberty(tid);
-                }
-            }
-            board_state_[tid] = EMPTY;
-            liberty_count_[tid] = SIZE_NONE;
 
-            zobrist_hash_value_ ^= g_zobrist_board_hash_weight[Opponent()][tid];
-        });
-        RecycleBlock(dieId[i]);
-    }
+template<int N>
+int GoStateT<N>::Move(const GoCoordId to) {
+    return Play(to, nullptr);
+}
 
-    FOR_USEDBLOCK(i) {
-        if (block_pool_[i].in_use && timestamp_ == visited_positions_[i]) {
-            GoBlock &blk = block_pool_[i];
-            blk.CountLiberty();
-            FOR_BLOCKSTONE(tid, blk, {
-                liberty_count_[tid] = blk.liberty;
-            });
 
-        }
-    }
-    ++move_count_[to];
-    board_state_[to] = Self();
+template<int N>
+int GoStateT<N>::Move(const GoCoordId x, const GoCoordId y) {
+    return Move(Board::CoordToId(x, y));
+}
 
-    HandOff();
-    GetSensibleMove();
 
-    if (positional_superko_) {
-        board_hash_states_.insert(zobrist_hash_value_);
-    }
-
-    return 0;
+template<int N>
+int GoStateT<N>::Move(const GoCoordId id, GoJournal &journal) {
+    journal.marks_.push_back(journal.entries_.size());
+    // what every move rewrites, scalars from current_player_ to zobrist_hash_value_ are declared contiguously,
+    // per point arrays are saved point by point as Play changes them
+    STATIC_ASSERT_ADJACENT(current_player_, last_position_);
+    STATIC_ASSERT_ADJACENT(last_position_, ko_position_);
+    STATIC_ASSERT_ADJACENT(ko_position_, is_double_pass_);
+    STATIC_ASSERT_ADJACENT(is_double_pass_, positional_superko_);
+    STATIC_ASSERT_ADJACENT(positional_superko_, superko_history_);
+    STATIC_ASSERT_ADJACENT(superko_history_, zobrist_hash_value_);
+    journal.Save(&current_player_, (char *)(&zobrist_hash_value_ + 1) - (char *)&current_player_);
+    journal.Save(legal_planes_, sizeof(legal_planes_));
+    journal.Save(surrounded_planes_, sizeof(surrounded_planes_));
+    journal.Save(stone_planes_, sizeof(stone_planes_));
+    int slot = history_count_ % HISTORY_SIZE;
+    journal.Save(history_planes_[slot], sizeof(history_planes_[slot]));
+    journal.Save(&history_hash_values_[slot], sizeof(history_hash_values_[slot]));
+    journal.Save(&history_count_, sizeof(history_count_));
+    int ret = Play(id, &journal);
+    if (ret != 0) {
+        Undo(journal);
+    }
+    return ret;
 }
 
 
-int GoState::Move(const GoCoordId x, const GoCoordId y) {
-    return Move(CoordToId(x, y));
+template<int N>
+void GoStateT<N>::Undo(GoJournal &journal) {
+    size_t mark = journal.marks_.back();
+    journal.marks_.pop_back();
+    while (journal.entries_.size() > mark) {
+        const GoJournal::Entry &e = journal.entries_.back();
+        switch (e.kind) {
+            case GoJournal::SAVE_BYTES:
+                memcpy(e.ptr, journal.bytes_.data() + e.offset, e.size);
+                journal.bytes_.resize(e.offset);
+                break;
+            case GoJournal::SAVE_POINT: {
+                GoCoordId id = e.size;
+                board_state_[id] = e.offset;
+                block_root_[id] = (GoCoordId)(e.value & 0xffff);
+                next_stone_[id] = (GoCoordId)(e.value >> 16 & 0xffff);
+                stone_count_[id] = (GoSize)(e.value >> 32 & 0xffff);
+                liberty_count_[id] = (GoSize)(e.value >> 48 & 0xffff);
+                break;
+            }
+            case GoJournal::INSERT_HASH:
+                static_cast<GoSuperkoHistory *>(e.ptr)->Erase(e.value);
+                break;
+        }
+        journal.entries_.pop_back();
+    }
 }
 
 
-void GoState::RecycleBlock(const GoBlockId id) {
-    block_pool_[id].in_use = false;
-    recycled_blocks_.push(id);
+template<int N>
+void GoStateT<N>::SavePoint(GoJournal *journal, const GoCoordId id) const {
+    if (journal) {
+        uint64_t value = (uint64_t)(uint16_t)block_root_[id] | (uint64_t)(uint16_t)next_stone_[id] << 16 |
+                         (uint64_t)(uint16_t)stone_count_[id] << 32 | (uint64_t)(uint16_t)liberty_count_[id] << 48;
+        journal->entries_.push_back(GoJournal::Entry{GoJournal::SAVE_POINT, nullptr, (uint32_t)id, board_state_[id], value});
+    }
 }
 
 
-void GoState::ShowBoard(bool bNoColor) const {
+template<int N>
+void GoStateT<N>::ShowBoard(bool bNoColor) const {
     GoCoordId y;
 
     fprintf(stderr, "current player: %d\n", current_player_);
@@ -494,11 +730,12 @@ void GoState::ShowBoard(bool bNoColor) const {
 }
 
 
-void GoState::ShowLibCount() const {
+template<int N>
+void GoStateT<N>::ShowLibCount() const {
     fprintf(stderr, "<-------------  lib  --------------->\n");
     for (GoCoordId x = 0; x < BORDER_SIZE; ++x) {
         for (GoCoordId y = 0; y < BORDER_SIZE; ++y) {
-            fprintf(stderr, "%d ", int(liberty_count_[CoordToId(x, y)]));
+            fprintf(stderr, "%d ", int(GetLibertyById(Board::CoordToId(x, y))));
         }
         fprintf(stderr, "\n");
     }
@@ -506,22 +743,12 @@ void GoState::ShowLibCount() const {
 }
 
 
-void GoState::ShowState() {
-    fprintf(stderr, "block in used: %d", int(block_in_use_));
-    FOR_USEDBLOCK(i) {
-        fprintf(stderr, "id %d: color %d, x %d y %d, stone %d lib %d\n",
-                int(i), int(block_pool_[i].color), int(block_pool_[i].head / BORDER_SIZE),
-                int(block_pool_[i].head % BORDER_SIZE), int(block_pool_[i].stone_count),
-                int(block_pool_[i].CountLiberty()));
-    }
-}
-
-
-void GoState::ShowLegalMap() const {
+template<int N>
+void GoStateT<N>::ShowLegalMap() const {
     fprintf(stderr, "<------------- legal --------------->\n");
     for (GoCoordId x = 0; x < BORDER_SIZE; ++x) {
         for (GoCoordId y = 0; y < BORDER_SIZE; ++y) {
-            fprintf(stderr, "%d ", int(legal_move_map_[CoordToId(x, y)]));
+            fprintf(stderr, "%d ", int(IsLegal(Board::CoordToId(x, y))));
         }
         fprintf(stderr, "\n");
     }
@@ -529,81 +756,47 @@ void GoState::ShowLegalMap() const {
 }
 
 
-GoSize GoState::TryMove(GoBlock &blk, const GoCoordId to, GoBlockId *nbId, GoBlockId *dieId, GoCoordId libNeed) {
-    if (!legal_move_map_[to]) {
-        return -1;
-    }
-    GoSize cnt = 0;
-
-    blk.Reset();
-    blk.stone_count = 1;
-    blk.color = Self();
-    GetNeighbourBlocks(blk, to, nbId);
-
-    dieId[0] = 0;
-
-    for (GoBlockId i = 1; i <= nbId[0]; ++i) {
-        GoBlock &tmp = block_pool_[nbId[i]];
-        if (Self() != tmp.color) {
-            if (1 == tmp.CountLiberty()) {
-                cnt += tmp.stone_count;
-                dieId[++dieId[0]] = nbId[i];
-            }
-        } else {
-            blk.TryMergeBlocks(tmp);
-        }
-    }
-    blk.ResetLiberty(to);
-    if (blk.CountLiberty() >= libNeed) {
-        return cnt;
+template<int N>
+uint64_t GoStateT<N>::GetHistoryHashValue() const {
+    // current position, then previous positions in feature history
+    uint64_t hash_value = zobrist_hash_value_;
+    for (uint32_t i = 2; i <= (uint32_t)HISTORY_SIZE; ++i) {
+        uint64_t h = i <= history_count_ ? history_hash_values_[(history_count_ - i) % HISTORY_SIZE] : 0;
+        hash_value = hash_value * 0x9e3779b97f4a7c15ULL ^ h;
     }
-    if (SIZE_NONE != dieId[0]) {
-        for (GoBlockId i = 1; i <= dieId[0]; ++i) {
-            const GoBlock &tmp = block_pool_[dieId[i]];
-            for (GoSize k = 0; k < LIBERTY_STATE_SIZE; ++k) {
-                blk.liberty_state[k] |= tmp.stone_state[k];
-                blk.liberty_state[k] &= blk.virtual_liberty_state[k];
-            }
-        }
-    }
-
-    return cnt;
+    return hash_value;
 }
 
-uint64_t GoState::GetNewHashValue(GoCoordId to)
-{
-    if (to == COORD_PASS) {
-        uint64_t new_zobrist_hash_value = zobrist_hash_value_;
-        new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Self()];
-        new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Opponent()];
-        return new_zobrist_hash_value;
-    }
-
-    GoBlockId blkId;
-    GoBlockId tmp[2][DELTA_SIZE + 1];
-
-    GetNewBlock(blkId);
-
-    GoBlock &blk = block_pool_[blkId];
-    TryMove(blk, to, tmp[0], tmp[1]);
 
+template<int N>
+uint64_t GoStateT<N>::GetNewHashValue(GoCoordId to) const {
     uint64_t new_zobrist_hash_value = zobrist_hash_value_;
-
     new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Self()];
     new_zobrist_hash_value ^= g_zobrist_player_hash_weight[Opponent()];
+    if (IsPass(to)) {
+        return new_zobrist_hash_value;
+    }
     new_zobrist_hash_value ^= g_zobrist_board_hash_weight[Self()][to];
 
-    GoBlockId *dieId = tmp[1];
-
-    for (GoBlockId j = 1; j <= dieId[0]; ++j) {
-        FOR_BLOCKSTONE(tid, block_pool_[dieId[j]], {
-            new_zobrist_hash_value ^= g_zobrist_board_hash_weight[Opponent()][tid];
-        });
+    // blocks captured by this move
+    GoCoordId roots[DELTA_SIZE];
+    int n = GetNeighbourBlocks(to, roots);
+    for (int i = 0; i < n; ++i) {
+        if (Opponent() != board_state_[roots[i]] || 1 != liberty_count_[roots[i]]) {
+            continue;
+        }
+        GoCoordId id = roots[i];
+        do {
+            new_zobrist_hash_value ^= g_zobrist_board_hash_weight[Opponent()][id];
+            id = next_stone_[id];
+        } while (id != roots[i]);
     }
-
-    RecycleBlock(blkId);
     return new_zobrist_hash_value;
 }
 
+#define GO_STATE_INSTANTIATE(n) template class GoStateT<n>;
+FOR_EACH_BOARD_SIZE(GO_STATE_INSTANTIATE)
+#undef GO_STATE_INSTANTIATE
+
 #undef y
 #undef x
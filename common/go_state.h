@@ -19,9 +19,8 @@
 
 #include <cstdlib>
 #include <cstring>
-#include <stack>
 #include <string>
-#include <unordered_set>
+#include <type_traits>
 #include <vector>
 
 // #include <glog/logging.h>
@@ -31,6 +30,11 @@
 #  include <intrin.h>
 #  define __builtin_popcount __popcnt
 #  define __builtin_popcountll __popcnt64
+inline int __builtin_ctzll(unsigned long long x) {
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return i;
+}
 #endif
 
 template<class IntType>
@@ -38,198 +42,104 @@ inline IntType Lowbit(const IntType &x) {
     return x & (-x);
 }
 
-#define FOR_BLOCKSTONE(id, blk, loop_body) { \
-    GoCoordId id = (blk).head; \
-    while (true) { \
-        loop_body \
-        if (id == stones_[id].next_id) { \
-            break; \
-        } \
-        id = stones_[id].next_id; \
-    } \
-}
-
-#define FOR_USEDBLOCK(id) \
-    for (GoBlockId id = 0; id < block_in_use_; ++id)
-#define FOR_BLOCKLIB(id, blk) \
-    for (GoCoordId id = (blk).LibBegin(); (blk).LibEnd() != id; id = (blk).LibNext(id))
-
-
-int popcount64(unsigned long long x);
-
-struct GoStone {
-    GoCoordId self_id;      // Id of this stone
-    GoBlockId block_id;     // Id of its block
-    GoCoordId next_id;      // Use like link-list
-    GoCoordId parent_id;    // Use like union-find-set (rooted by tail)
-
-    // inline void SetSelfId(GoCoordId id) { self_id = id; }
-
-    inline void Reset(GoCoordId id = GoComm::COORD_UNSET) {
-        next_id = parent_id = self_id;
-        block_id = id;
-    }
-} ;
-
-struct GoBlock {
-    GoBlockId self_id;          // Id of this block
-    GoStoneColor color;         // Color of this block
-    GoSize liberty;             // Last liberty count
-    GoCoordId head, tail;       // Stones record
-    GoSize stone_count;         // Stone count
-    GoStone *stones;            // Stone detail
-    bool in_use;                // Block is in use
-
-    uint64_t liberty_state[GoComm::LIBERTY_STATE_SIZE];             // Liberties
-    uint64_t virtual_liberty_state[GoComm::LIBERTY_STATE_SIZE];     // Virtual liberties
-    uint64_t stone_state[GoComm::BOARD_STATE_SIZE];                 // Stones
-
-    // inline void SetSelfId(int id) { self_id = id; }
-
-    GoCoordId LibBegin() const {
-        for (GoSize i = 0; i < GoComm::LIBERTY_STATE_SIZE; ++i) {
-            if (0 == liberty_state[i]) {
-                continue;
-            }
-            return g_log2_table[Lowbit(liberty_state[i]) % 67] + (i << 6);
-        }
-        return LibEnd();
-    }
-
-    GoCoordId LibEnd() const { return GoComm::GOBOARD_SIZE; }
-
-    GoCoordId LibNext(const int id) const {
-        // & 63 to find pos, + 1 to pass corresponding pos
-        uint64_t val = 0;
-        if (63 != (id & 63)) {
-            val = liberty_state[id >> 6] & (uint64_t(-1) << ((id & 63) + 1));
-        }
-        for (GoSize i = id >> 6; i < GoComm::LIBERTY_STATE_SIZE; ) {
-            if (0 == val) {
-                ++i;
-                val = liberty_state[i];
-            } else {
-                return g_log2_table[Lowbit(val) % 67] + (i << 6);
-            }
-        }
-        return LibEnd();
-    }
-
-    void Reset() {
-        memset(liberty_state, 0, sizeof(liberty_state));
-        memset(virtual_liberty_state, 0, sizeof(virtual_liberty_state));
-        memset(stone_state, 0, sizeof(stone_state));
-        in_use = false;
-        head = tail = GoComm::COORD_UNSET;
-        liberty = stone_count = GoComm::SIZE_NONE;
-    }
+// Positions of a game, for positional superko.
+// Kept outside GoState so that copying a board costs nothing for it,
+// boards copied from each other share the history unless given their own one.
+// A history may stack on a base history, e.g. positions of a search descent on positions up to the root,
+// the base is shared read-only and must not change while stacked histories are in use.
+// Positions are kept in an open addressing table, hash 0 is kept aside as it marks empty slots.
+class GoSuperkoHistory {
+ public:
+    explicit GoSuperkoHistory(const GoSuperkoHistory *base = nullptr)
+        : base_(base), size_(0), has_zero_(false) {}
 
-    inline void SetLiberty(const GoCoordId id) {
-        liberty_state[id >> 6] |= 1ULL << (id & 63);
+    bool Contains(uint64_t hash) const {
+        return ContainsOwn(hash) || (base_ && base_->Contains(hash));
     }
 
-    inline void SetVirtLiberty(const GoCoordId id) {
-        virtual_liberty_state[id >> 6] |= 1ULL << (id & 63);
-    }
+    // false if the position is known already
+    bool Insert(uint64_t hash);
 
-    inline void SetStoneState(const GoCoordId id) {
-        stone_state[id >> 6] |= 1ULL << (id & 63);
-    }
+    void Erase(uint64_t hash);
 
-    inline void ResetLiberty(const GoCoordId id) {
-        liberty_state[id >> 6] &= ~(1ULL << (id & 63));
-    }
+    // drop own positions and stack on base instead
+    void Reset(const GoSuperkoHistory *base);
 
-    inline void ResetVirtLiberty(const GoCoordId id) {
-        virtual_liberty_state[id >> 6] &= ~(1ULL << (id & 63));
-    }
+    void Clear() { Reset(base_); }
 
-    inline void ResetStoneState(const GoCoordId id) {
-        stone_state[id >> 6] &= ~(1ULL << (id & 63));
-    }
+ private:
+    bool ContainsOwn(uint64_t hash) const;
 
-    inline bool GetLiberty(const GoCoordId id) const {
-        return liberty_state[id >> 6] & (1ULL << (id & 63));
-    }
+    size_t Slot(uint64_t hash) const { return (hash * 0x9e3779b97f4a7c15ULL >> 32) & (slots_.size() - 1); }
 
-    GoCoordId GetLowestLiberty() const {
-        for (GoSize i = 0; i < GoComm::LIBERTY_STATE_SIZE; ++i) {
-            const uint64_t &st = liberty_state[i];
-            if (0 != st) {
-                return g_log2_table[Lowbit(st) % 67] + (i << 6);
-            }
-        }
-        // CHECK(false) << "Wow~ A block without liberty found! stone size: " << stone_count
-        // << "\tstone color: " << GoComm::COLOR_STR[color];
-        return GoComm::COORD_UNSET;
-    }
+    const GoSuperkoHistory *base_;
+    std::vector<uint64_t> slots_;   // linear probing, size is power of 2
+    size_t size_;
+    bool has_zero_;
+} ;
 
-    bool IsNoLiberty() {
-        return GoComm::SIZE_NONE == this->CountLiberty();
-    }
 
-    inline GoSize CountLiberty() {
-        return liberty = __builtin_popcountll(liberty_state[0]) +
-            __builtin_popcountll(liberty_state[1]) +
-            __builtin_popcountll(liberty_state[2]) +
-            __builtin_popcountll(liberty_state[3]) +
-            __builtin_popcountll(liberty_state[4]) +
-            __builtin_popcountll(liberty_state[5]);
-    }
-
-    GoStone *GetHead() const {
-        return this->stones + this->head;
+// Undo log of moves made by GoState::Move(id, journal).
+// Entries refer to the board by address, so a journal is bound to one board until all its moves are undone.
+class GoJournal {
+ public:
+    int NumMoves() const { return marks_.size(); }
+
+ private:
+    enum { SAVE_BYTES, SAVE_POINT, INSERT_HASH };
+
+    struct Entry {
+        int kind;
+        void *ptr;          // SAVE_BYTES: where the saved bytes go back to, INSERT_HASH: GoSuperkoHistory
+        uint32_t size;      // SAVE_POINT: point id
+        uint32_t offset;    // SAVE_BYTES: offset in bytes_, SAVE_POINT: stone color
+        uint64_t value;     // SAVE_POINT: block root, next stone, stone count and liberty count, INSERT_HASH: hash
+    };
+
+    void Save(void *ptr, uint32_t size) {
+        entries_.push_back(Entry{SAVE_BYTES, ptr, size, (uint32_t)bytes_.size(), 0});
+        bytes_.insert(bytes_.end(), (char *)ptr, (char *)ptr + size);
     }
 
-    GoStone *GetTail() const {
-        return this->stones + this->tail;
+    void Push(int kind, void *ptr, uint64_t value) {
+        entries_.push_back(Entry{kind, ptr, 0, 0, value});
     }
 
-    // for merging block-a into this
-    int TryMergeBlocks(const GoBlock &a) {
-        // CHECK(GoComm::SIZE_NONE != a.stone_count) << "block \"a\" is empty";
-        // CHECK(GoComm::SIZE_NONE != this->stone_count) << "block \"this\" is empty";
-        // CHECK_NE(this->self_id, a.self_id) << "Trying to merge the same block, id " << this->self_id;
-        // merge liberty
-        this->stone_count += a.stone_count;
-        for (GoSize i = 0; i < GoComm::LIBERTY_STATE_SIZE; ++i) {
-            this->stone_state[i] |= a.stone_state[i];
-            this->virtual_liberty_state[i] |= a.virtual_liberty_state[i];
-            this->virtual_liberty_state[i] &= ~this->stone_state[i];
-            this->liberty_state[i] |= a.liberty_state[i];
-            this->liberty_state[i] &= this->virtual_liberty_state[i];
-        }
-        return 0;
-    }
+    std::vector<Entry> entries_;
+    std::vector<char> bytes_;
+    std::vector<size_t> marks_;     // size of entries_ before each move
 
-    void MergeBlocks(const GoBlock &a) {
-        // CHECK(GoComm::SIZE_NONE != a.stone_count) << "block \"a\" is empty";
-        // CHECK(GoComm::SIZE_NONE != this->stone_count) << "block \"this\" is empty";
-        // CHECK_NE(this->self_id, a.self_id) << "Trying to merge the same block, id " << this->self_id;
-        // merge stones
-        a.GetTail()->next_id = this->GetHead()->self_id;
-        this->head = a.head;
-        a.GetTail()->parent_id = this->GetTail()->self_id;
-    }
+    template<int N> friend class GoStateT;
 } ;
 
-class GoState {
+
+// Board of a game of border size N, a few KB of plain data, copied by memcpy and allocates nothing.
+// Blocks are not stored separately, each block keeps its stone count and liberty count at its root stone.
+// Instantiated for sizes of FOR_EACH_BOARD_SIZE, GoState is the 19x19 one.
+template<int N>
+class GoStateT {
  public:
-    GoState(bool positional_superko = true);
+    typedef GoBoard<N> Board;
 
-    GoState(const GoState &gms);
+    static constexpr GoCoordId BORDER_SIZE = Board::BORDER_SIZE;
+    static constexpr GoCoordId GOBOARD_SIZE = Board::GOBOARD_SIZE;
+    static constexpr GoSize BOARD_STATE_SIZE = Board::BOARD_STATE_SIZE;
 
-    ~GoState();
+    GoStateT(bool positional_superko = true);
 
 
     // basic functions
+    // Tromp-Taylor area score by bitboard flood fill, returns black - white
     GoSize CalcScore(GoSize &black, GoSize &white, GoSize &empty) const;
 
+    // Reference implementation by flood fill point by point, same result as CalcScore.
+    GoSize CalcScoreScalar(GoSize &black, GoSize &white, GoSize &empty) const;
+
     GoStoneColor GetWinner(GoSize &score) const;
 
     GoStoneColor GetWinner() const;
 
-    void CopyFrom(const GoState &src);
+    void CopyFrom(const GoStateT &src) { *this = src; }
 
     inline GoStoneColor CurrentPlayer() const { return current_player_; }
 
@@ -238,19 +148,22 @@ class GoState {
     void GetLastMove(GoCoordId &x, GoCoordId &y);
 
     GoSize GetLibertyByCoor(const GoCoordId x, const GoCoordId y) const {
-        return GetLibertyById(GoFunction::CoordToId(x, y));
+        return GetLibertyById(Board::CoordToId(x, y));
     }
 
-    inline GoSize GetLibertyById(const GoCoordId id) const { return liberty_count_[id]; }
+    inline GoSize GetLibertyById(const GoCoordId id) const {
+        return GoComm::EMPTY == board_state_[id] ? GoComm::SIZE_NONE : liberty_count_[block_root_[id]];
+    }
 
     inline void HandOff() { current_player_ = Opponent(); }
 
     bool IsDoublePass() const { return is_double_pass_; }
 
-    inline bool IsLegal(const GoCoordId id) const { return GoFunction::IsPass(id) || legal_move_map_[id]; }
-    // inline bool IsLegal(const GoCoordId id) const { return legal_move_map_[id]; }
+    inline bool IsLegal(const GoCoordId id) const {
+        return GoFunction::IsPass(id) || (legal_planes_[id >> 6] >> (id & 63) & 1);
+    }
 
-    bool IsLegal(const GoCoordId x, const GoCoordId y) { return IsLegal(GoFunction::CoordToId(x, y)); }
+    bool IsLegal(const GoCoordId x, const GoCoordId y) { return IsLegal(Board::CoordToId(x, y)); }
 
     bool IsMovable() const;
 
@@ -258,6 +171,11 @@ class GoState {
 
     int Move(const GoCoordId x, const GoCoordId y);
 
+    // Undoable move, much cheaper than copying the board to try moves on
+    int Move(const GoCoordId id, GoJournal &journal);
+
+    void Undo(GoJournal &journal);
+
     inline GoStoneColor Opponent(const GoStoneColor color = GoComm::COLOR_UNKNOWN) const {
         return GoComm::BLACK + GoComm::WHITE
             - (GoComm::COLOR_UNKNOWN != color ? color : current_player_);
@@ -265,79 +183,77 @@ class GoState {
 
     inline GoStoneColor Self() const { return current_player_; }
 
-    GoSize TryMove(GoBlock &blk, const GoCoordId id, GoBlockId *nbId, GoBlockId *dieId, GoSize libCnt = GoComm::GOBOARD_SIZE); // nbId, dieId: size should be at least 5
+    // positional superko is checked only when a history is set
+    void SetSuperkoHistory(GoSuperkoHistory *history) { superko_history_ = history; }
 
+    GoSuperkoHistory *GetSuperkoHistory() const { return superko_history_; }
 
-    // features for rollout
-    const GoStoneColor *GetBoard() const { return board_state_; }
 
-    const bool *GetLegal() const { return legal_move_map_; }
-
-    const GoSize *GetLib() const { return liberty_count_; }
-
-    const GoSize *GetMoveCount() const { return move_count_; }
+    // features
+    const GoStoneColor *GetBoard() const { return board_state_; }
 
-    const GoSize &GetTs() const { return timestamp_; };
+    // legal moves except pass, BOARD_STATE_SIZE words, bit of point id is [id >> 6] >> (id & 63)
+    const uint64_t *GetLegalPlane() const { return legal_planes_; }
 
     std::vector<bool> GetFeature() const;
 
+    // the same features as GetFeature, one bitboard per plane, bit of point id is planes[plane][id >> 6] >> (id & 63),
+    // planes are sized for the largest board, words after BOARD_STATE_SIZE are cleared
+    void GetFeaturePlanes(uint64_t planes[][GoComm::BOARD_STATE_SIZE]) const;
+
     const std::string GetFeatureString() const;
 
     const std::string GetLastFeaturePlane() const;
 
 
-    // for lgr
-    const GoBlock& GetBlockById(GoCoordId id) {
-        GoBlockId blk_id = stones_[FindCoord(id)].block_id;
-        return block_pool_[blk_id];
-    }
-
     // for debug
     void ShowBoard(bool bNoColor = false) const;
 
     void ShowLibCount() const;
 
-    void ShowState();
-
     void ShowLegalMap() const;
 
     uint64_t GetHashValue() const { return zobrist_hash_value_; }
 
-    uint64_t GetNewHashValue(GoCoordId to);
+    uint64_t GetHistoryHashValue() const; // hash of positions in feature history
+
+    uint64_t GetNewHashValue(GoCoordId to) const;
 
 
  protected:
-    GoSize CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, bool *vis) const;
+    int Play(const GoCoordId to, GoJournal *journal);
 
-    void CalcScoreWithColor(GoSize &cnt, const GoStoneColor color) const;
+    // journal entries of point id in per point arrays, before any of them changes
+    void SavePoint(GoJournal *journal, const GoCoordId id) const;
 
-    GoCoordId FindCoord(const GoCoordId id);
+    GoSize CalcRegionScore(const GoCoordId &xy, const GoStoneColor color, bool *vis) const;
 
-    void FixBlockInfo();
+    void CalcScoreWithColor(GoSize &cnt, const GoStoneColor color) const;
 
-    GoSize GetLibertyByBlock(const GoBlock &blk) { return GetLibertyById(blk.head); }
+    // distinct blocks around id, returns count
+    int GetNeighbourBlocks(const GoCoordId id, GoCoordId *roots) const;
 
-    GoBlockId GetBlockIdByCoord(const GoCoordId id);
+    void PlaceStone(const GoCoordId to, GoJournal *journal);
 
-    void GetNeighbourBlocks(GoBlock &blk, const GoCoordId to, GoBlockId *nbId);
+    GoSize RemoveBlock(const GoCoordId root, GoJournal *journal);
 
-    void GetSensibleMove();
+    void MergeBlocks(GoCoordId a, GoCoordId b, GoJournal *journal);
 
+    void UpdateSurrounded(const GoCoordId id);
 
- protected:
-    // need RecycleBlock after used!!!
-    void GetNewBlock(GoBlockId &id);
+    const uint64_t *GetHistoryPlane(int i) const; // i-th feature plane
 
-    void RecycleBlock(const GoBlockId id);
+    void GetSensibleMove();
 
 
  protected:
     // board utils
-    GoBlock block_pool_[GoComm::MAX_BLOCK_SIZE];
-    std::stack<GoBlockId> recycled_blocks_;
-    GoSize block_in_use_;
-    GoStone stones_[GoComm::GOBOARD_SIZE];
-    GoStoneColor board_state_[GoComm::GOBOARD_SIZE];
+    GoStoneColor board_state_[GOBOARD_SIZE];
+    GoCoordId block_root_[GOBOARD_SIZE];        // root stone of block, COORD_UNSET for empty point
+    GoCoordId next_stone_[GOBOARD_SIZE];        // circular list of stones in block
+    GoSize stone_count_[GOBOARD_SIZE];          // valid at root stone
+    GoSize liberty_count_[GOBOARD_SIZE];        // valid at root stone
+    // current_player_ to zobrist_hash_value_ are journaled as one byte range by Move, keep them in order
     GoStoneColor current_player_;
     GoCoordId last_position_;
     GoCoordId ko_position_;
@@ -345,18 +261,28 @@ class GoState {
     bool positional_superko_;
 
     // hash board state
-    std::unordered_set<uint64_t> board_hash_states_;
+    GoSuperkoHistory *superko_history_;
     uint64_t zobrist_hash_value_;
 
-    // visit status
-    GoSize timestamp_;
-    GoSize visited_positions_[GoComm::MAX_BLOCK_SIZE];
-
     // features
-    bool legal_move_map_[GoComm::GOBOARD_SIZE];
-    GoSize liberty_count_[GoComm::GOBOARD_SIZE];
-    GoSize move_count_[GoComm::GOBOARD_SIZE];
-
-    std::vector<std::string> feature_history_list_;
+    uint64_t legal_planes_[BOARD_STATE_SIZE];
+    uint64_t surrounded_planes_[BOARD_STATE_SIZE];    // empty points without empty neighbour
+
+    // black and white stones of last SIZE_HISTORYEACHSIDE / 2 positions, ring indexed by history_count_
+    uint64_t stone_planes_[2][BOARD_STATE_SIZE];
+    uint64_t history_planes_[GoFeature::SIZE_HISTORYEACHSIDE / 2][2][BOARD_STATE_SIZE];
+    uint64_t history_hash_values_[GoFeature::SIZE_HISTORYEACHSIDE / 2];
+    uint32_t history_count_;
 } ;
 
+template<int N> constexpr GoCoordId GoStateT<N>::BORDER_SIZE;
+template<int N> constexpr GoCoordId GoStateT<N>::GOBOARD_SIZE;
+template<int N> constexpr GoSize GoStateT<N>::BOARD_STATE_SIZE;
+
+#define GO_STATE_EXTERN_TEMPLATE(n) extern template class GoStateT<n>;
+FOR_EACH_BOARD_SIZE(GO_STATE_EXTERN_TEMPLATE)
+#undef GO_STATE_EXTERN_TEMPLATE
+
+typedef GoStateT<GoComm::BORDER_SIZE> GoState;
+
+static_assert(std::is_trivially_copyable<GoState>::value, "GoState should be trivially copyable");
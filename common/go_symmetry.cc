@@ -0,0 +1,132 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "go_symmetry.h"
+
+using namespace GoComm;
+
+namespace GoSymmetry {
+
+static_assert(BORDER_SIZE <= 32, "rows of the board should fit in uint32_t");
+
+template<int N>
+static void PlaneToRows(const uint64_t *plane, uint32_t rows[32]) {
+    for (int x = 0; x < N; ++x) {
+        int offset = x * N, w = offset >> 6, s = offset & 63;
+        uint64_t bits = plane[w] >> s;
+        if (s + N > 64) {
+            bits |= plane[w + 1] << (64 - s);
+        }
+        rows[x] = bits & ((1u << N) - 1);
+    }
+    for (int x = N; x < 32; ++x) {
+        rows[x] = 0;
+    }
+}
+
+template<int N>
+static void RowsToPlane(const uint32_t rows[32], uint64_t *plane) {
+    for (int w = 0; w < GoBoard<N>::BOARD_STATE_SIZE; ++w) {
+        plane[w] = 0;
+    }
+    for (int x = 0; x < N; ++x) {
+        int offset = x * N, w = offset >> 6, s = offset & 63;
+        plane[w] |= (uint64_t)rows[x] << s;
+        if (s + N > 64) {
+            plane[w + 1] |= (uint64_t)rows[x] >> (64 - s);
+        }
+    }
+}
+
+template<int N>
+static void MirrorRows(uint32_t rows[32]) {
+    for (int x = 0; x < N / 2; ++x) {
+        std::swap(rows[x], rows[N - x - 1]);
+    }
+}
+
+// bit y of each row to bit N - y - 1
+template<int N>
+static void MirrorBits(uint32_t rows[32]) {
+    for (int x = 0; x < N; ++x) {
+        uint32_t v = rows[x];
+        v = (v >> 1 & 0x55555555) | (v & 0x55555555) << 1;
+        v = (v >> 2 & 0x33333333) | (v & 0x33333333) << 2;
+        v = (v >> 4 & 0x0f0f0f0f) | (v & 0x0f0f0f0f) << 4;
+        v = (v >> 8 & 0x00ff00ff) | (v & 0x00ff00ff) << 8;
+        v = v >> 16 | v << 16;
+        rows[x] = v >> (32 - N);
+    }
+}
+
+// swap the upper right and lower left J x J blocks of each 2J x 2J block on the diagonal
+template<int J>
+static void TransposeBlocks(uint32_t rows[32], uint32_t mask) {
+    for (int k = 0; k < 32; k += 2 * J) {
+        for (int i = k; i < k + J; ++i) {
+            uint32_t t = (rows[i] >> J ^ rows[i + J]) & mask;
+            rows[i] ^= t << J;
+            rows[i + J] ^= t;
+        }
+    }
+}
+
+// bit y of row x to bit x of row y
+static void Transpose(uint32_t rows[32]) {
+    TransposeBlocks<16>(rows, 0x0000ffff);
+    TransposeBlocks<8>(rows, 0x00ff00ff);
+    TransposeBlocks<4>(rows, 0x0f0f0f0f);
+    TransposeBlocks<2>(rows, 0x33333333);
+    TransposeBlocks<1>(rows, 0x55555555);
+}
+
+template<int N>
+void TransformPlane(uint64_t plane[BOARD_STATE_SIZE], int mode, bool reverse) {
+    if (mode == 0) {
+        return;
+    }
+    uint32_t rows[32];
+    PlaneToRows<N>(plane, rows);
+    if ((mode & 4) && !reverse) {
+        Transpose(rows);
+    }
+    if (mode & 1) {
+        MirrorRows<N>(rows);
+    }
+    if (mode & 2) {
+        MirrorBits<N>(rows);
+    }
+    if ((mode & 4) && reverse) {
+        Transpose(rows);
+    }
+    RowsToPlane<N>(rows, plane);
+}
+
+template<int N>
+void TransformPlanes(uint64_t planes[][BOARD_STATE_SIZE], int num_planes, int mode, bool reverse) {
+    for (int i = 0; i < num_planes; ++i) {
+        TransformPlane<N>(planes[i], mode, reverse);
+    }
+}
+
+#define GO_SYMMETRY_INSTANTIATE(n) \
+    template void TransformPlane<n>(uint64_t plane[BOARD_STATE_SIZE], int mode, bool reverse); \
+    template void TransformPlanes<n>(uint64_t planes[][BOARD_STATE_SIZE], int num_planes, int mode, bool reverse);
+FOR_EACH_BOARD_SIZE(GO_SYMMETRY_INSTANTIATE)
+#undef GO_SYMMETRY_INSTANTIATE
+
+} // namespace GoSymmetry
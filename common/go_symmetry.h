@@ -0,0 +1,87 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <utility>
+
+#include "go_comm.h"
+
+// The 8 symmetries of the board of border size N, numbered by mode:
+// bit 0 mirrors x, bit 1 mirrors y, bit 2 swaps x and y after mirroring.
+// Transforming features by mode means point i of the result is point GetTransformTable(mode)[i] of the source,
+// transforming with reverse undoes the transform by mode.
+namespace GoSymmetry {
+
+const int NUM_MODES = 8;
+
+template<int N>
+constexpr GoCoordId Mirror(GoCoordId v, bool mirror) {
+    return mirror ? N - v - 1 : v;
+}
+
+template<int N>
+constexpr GoCoordId TransformId(int id, int mode, bool reverse) {
+    return reverse ? ((mode & 4) ? Mirror<N>(id % N, mode & 1) * N + Mirror<N>(id / N, mode & 2)
+                                 : Mirror<N>(id / N, mode & 1) * N + Mirror<N>(id % N, mode & 2))
+                   : ((mode & 4) ? Mirror<N>(id % N, mode & 2) * N + Mirror<N>(id / N, mode & 1)
+                                 : Mirror<N>(id / N, mode & 1) * N + Mirror<N>(id % N, mode & 2));
+}
+
+// row mode * 2 + reverse
+template<int N>
+constexpr GoCoordId TransformTableEntry(int i) {
+    return TransformId<N>(i % (N * N), i / (N * N) / 2, i / (N * N) % 2);
+}
+
+template<int N = GoComm::BORDER_SIZE>
+inline const GoCoordId *GetTransformTable(int mode, bool reverse = false) {
+    return GoTables::Table2D<GoCoordId, NUM_MODES * 2, N * N, TransformTableEntry<N>>::data[mode * 2 + reverse];
+}
+
+// In place, features are N * N points of features.size() / (N * N) values each.
+// Every symmetry permutes points in cycles of at most 4, each cycle is rotated from its smallest point.
+template<int N = GoComm::BORDER_SIZE, class T>
+void TransformFeatures(T &features, int mode, bool reverse = false) {
+    const GoCoordId *from = GetTransformTable<N>(mode, reverse);
+    int depth = features.size() / (N * N);
+    for (int i = 0; i < N * N; ++i) {
+        int j = from[i];
+        while (j > i) j = from[j];
+        if (j < i || from[i] == i) {
+            continue;
+        }
+        for (int k = 0; k < depth; ++k) {
+            typename T::value_type first = features[i * depth + k];
+            for (j = i; from[j] != i; j = from[j]) {
+                features[j * depth + k] = features[from[j] * depth + k];
+            }
+            features[j * depth + k] = first;
+        }
+    }
+}
+
+// In place on a bitboard, bit of point id is plane[id >> 6] >> (id & 63),
+// works on rows of the board: mirrors reverse rows or bits in rows, swapping x and y transposes the rows.
+// Only the first GoBoard<N>::BOARD_STATE_SIZE words are touched.
+template<int N = GoComm::BORDER_SIZE>
+void TransformPlane(uint64_t plane[GoComm::BOARD_STATE_SIZE], int mode, bool reverse = false);
+
+template<int N = GoComm::BORDER_SIZE>
+void TransformPlanes(uint64_t planes[][GoComm::BOARD_STATE_SIZE], int num_planes, int mode, bool reverse = false);
+
+} // namespace GoSymmetry
@@ -0,0 +1,306 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "task_queue.h"
+
+// Bounded multi-producer multi-consumer ring, a TaskQueue without a lock on the fast path.
+// Each cell carries a sequence number telling whether it is ready for the push or the pop of a round,
+// producers and consumers claim positions by CAS on tail and head.
+// A thread finding the queue full or empty spins a while, then parks on a condition variable,
+// which is only notified when someone is parked, so busy queues never touch the mutex.
+// PushFront is rare (retry of timeout tasks), it goes to a locked deque popped before the ring.
+template<class T>
+class LockFreeTaskQueue: public TaskQueueBase<T>
+{
+ public:
+    // capacity is rounded up to a power of 2
+    LockFreeTaskQueue(int capacity)
+        : m_head(0), m_tail(0), m_num_front(0), m_num_parked_pop(0), m_num_parked_push(0), m_is_close(false)
+    {
+        size_t size = 2;
+        while (size < (size_t)capacity) size <<= 1;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool Push(T &&elem) override
+    {
+        if (m_is_close) {
+            return false;
+        }
+        for (int spins = 0; !TryPush(elem); ++spins) {
+            if (spins < k_spins) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_num_parked_push.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in WakePush
+            m_push_cond.wait(lock, [this]{ return !IsFull() || m_is_close; });
+            m_num_parked_push.fetch_sub(1);
+            if (m_is_close) {
+                return false;
+            }
+        }
+        WakePop();
+        return true;
+    }
+
+    void PushFront(T elem) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_front_mutex);
+            m_front.push_back(std::move(elem));
+            m_num_front.fetch_add(1);
+        }
+        WakePop();
+    }
+
+    bool Pop(T &elem, int64_t timeout_us = -1) override
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+        while (!TryPopAny(elem)) {
+            int64_t remain_us = RemainUs(deadline);
+            if (timeout_us >= 0 && remain_us <= 0) {
+                return false;
+            }
+            if (!WaitReady(timeout_us < 0 ? nullptr : &remain_us)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int PopBatch(std::vector<T> &elems, int max_num, int64_t batch_timeout_us) override
+    {
+        if (max_num <= 0) {
+            return 0;
+        }
+        T elem;
+        while (!TryPopAny(elem)) {
+            if (!WaitReady(nullptr)) {
+                return 0;
+            }
+        }
+        elems.push_back(std::move(elem));
+        int num = 1;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(batch_timeout_us);
+        for (;;) {
+            while (num < max_num && TryPopAny(elem)) {
+                elems.push_back(std::move(elem));
+                ++num;
+            }
+            if (num == max_num || m_is_close) {
+                break;
+            }
+            int64_t remain_us = RemainUs(deadline);
+            if (remain_us <= 0 || !WaitReady(&remain_us)) {
+                break;
+            }
+        }
+        return num;
+    }
+
+    void Close() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_close = true;
+        }
+        m_push_cond.notify_all();
+        m_pop_cond.notify_all();
+    }
+
+    bool IsClose() const override
+    {
+        return m_is_close;
+    }
+
+    int Size() const override
+    {
+        int64_t size = (int64_t)(m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed));
+        return (size > 0 ? size : 0) + m_num_front.load(std::memory_order_relaxed);
+    }
+
+ private:
+    static const int k_spins = 64;
+    static const int k_cache_line_size = 64;
+
+    struct Cell
+    {
+        std::atomic<size_t> seq; // pos if free for push of pos, pos + 1 if ready for pop of pos
+        T data;
+    };
+
+    bool TryPush(T &elem)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            intptr_t dif = (intptr_t)cell.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(elem);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T &elem)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            intptr_t dif = (intptr_t)cell.seq.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    elem = std::move(cell.data);
+                    cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPopAny(T &elem)
+    {
+        if (m_num_front.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_front_mutex);
+            if (!m_front.empty()) {
+                elem = std::move(m_front.back());
+                m_front.pop_back();
+                m_num_front.fetch_sub(1);
+                return true;
+            }
+        }
+        if (TryPop(elem)) {
+            WakePush();
+            return true;
+        }
+        return false;
+    }
+
+    // whether the cell at head holds an element, the next TryPop may still lose it to another consumer
+    bool IsReady() const
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        return m_cells[pos & m_mask].seq.load(std::memory_order_acquire) == pos + 1 ||
+               m_num_front.load(std::memory_order_relaxed) > 0;
+    }
+
+    bool IsFull() const
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        return m_cells[pos & m_mask].seq.load(std::memory_order_acquire) != pos;
+    }
+
+    static int64_t RemainUs(std::chrono::steady_clock::time_point deadline)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+    }
+
+    // Spins then parks until an element may be popped, false if timeout or closed and empty.
+    // timeout_us is null for no timeout.
+    bool WaitReady(const int64_t *timeout_us)
+    {
+        for (int spins = 0; spins < k_spins; ++spins) {
+            if (IsReady()) {
+                return true;
+            }
+            if (m_is_close) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_num_parked_pop.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in WakePop
+        auto ready = [this]{ return IsReady() || m_is_close; };
+        bool ret = true;
+        if (timeout_us == nullptr) {
+            m_pop_cond.wait(lock, ready);
+        } else {
+            ret = m_pop_cond.wait_for(lock, std::chrono::microseconds(*timeout_us), ready);
+        }
+        m_num_parked_pop.fetch_sub(1);
+        return ret && IsReady();
+    }
+
+    // pushed elements are seen by threads parking after the fence, others are parked already
+    void WakePop()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_num_parked_pop.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pop_cond.notify_one();
+        }
+    }
+
+    void WakePush()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_num_parked_push.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_push_cond.notify_one();
+        }
+    }
+
+ private:
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    char m_padding0[k_cache_line_size];
+    std::atomic<size_t> m_head;
+    char m_padding1[k_cache_line_size - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+    char m_padding2[k_cache_line_size - sizeof(std::atomic<size_t>)];
+
+    std::mutex m_front_mutex;
+    std::deque<T> m_front;
+    std::atomic<int> m_num_front;
+
+    std::mutex m_mutex;
+    std::condition_variable m_pop_cond;
+    std::condition_variable m_push_cond;
+    std::atomic<int> m_num_parked_pop;
+    std::atomic<int> m_num_parked_push;
+    std::atomic<bool> m_is_close;
+};
@@ -0,0 +1,178 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "task_queue.h"
+
+// TaskQueue popping elems by priority, T has a float member priority in [0, 1], higher is served first.
+// Starvation is bounded by aging: an elem of priority p pushed as the i-th ranks as i - p * max_overtake,
+// so it is never overtaken by elems pushed more than max_overtake after it. Equal ranks are served FIFO.
+// PushFront elems are served before all others, in LIFO order as TaskQueue.
+template<class T>
+class PriorityTaskQueue: public TaskQueueBase<T>
+{
+ public:
+    PriorityTaskQueue(int capacity = 0, int max_overtake = 64)
+        : m_capacity(capacity), m_max_overtake(max_overtake), m_seq(0), m_size(0), m_is_close(false)
+    {
+    }
+
+    bool Push(T &&elem) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_capacity > 0) {
+            m_push_cond.wait(lock, [this]{ return (int)m_heap.size() < m_capacity || m_is_close; });
+        }
+        if (m_is_close) {
+            return false;
+        }
+        int64_t seq = m_seq++;
+        int64_t rank = seq - (int64_t)std::lround(std::min(std::max(elem.priority, 0.0f), 1.0f) * m_max_overtake);
+        m_heap.push(Item{rank, seq, std::move(elem)});
+        m_size = SizeLocked();
+        lock.unlock();
+        m_pop_cond.notify_one();
+        return true;
+    }
+
+    void PushFront(T elem) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_front.push_front(std::move(elem));
+        m_size = SizeLocked();
+        lock.unlock();
+        m_pop_cond.notify_one();
+    }
+
+    bool Pop(T &elem, int64_t timeout_us = -1) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (timeout_us < 0) {
+            m_pop_cond.wait(lock, [this]{ return SizeLocked() > 0 || m_is_close; });
+        } else {
+            if (!m_pop_cond.wait_for(lock, std::chrono::microseconds(timeout_us),
+                                 [this]{ return SizeLocked() > 0 || m_is_close; })) {
+                return false;
+            }
+        }
+        if (SizeLocked() == 0) {
+            return false;
+        }
+        PopLocked(elem);
+        m_size = SizeLocked();
+        lock.unlock();
+        if (m_capacity > 0) {
+            m_push_cond.notify_one();
+        }
+        return true;
+    }
+
+    int PopBatch(std::vector<T> &elems, int max_num, int64_t batch_timeout_us) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pop_cond.wait(lock, [this]{ return SizeLocked() > 0 || m_is_close; });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(batch_timeout_us);
+        int num = 0;
+        for (;;) {
+            for (; num < max_num && SizeLocked() > 0; ++num) {
+                elems.emplace_back();
+                PopLocked(elems.back());
+            }
+            if (num == max_num || m_is_close ||
+                !m_pop_cond.wait_until(lock, deadline, [this]{ return SizeLocked() > 0 || m_is_close; })) {
+                break;
+            }
+        }
+        m_size = SizeLocked();
+        lock.unlock();
+        if (m_capacity > 0 && num > 0) {
+            m_push_cond.notify_all();
+        }
+        return num;
+    }
+
+    void Close() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_close = true;
+        }
+        m_push_cond.notify_all();
+        m_pop_cond.notify_all();
+    }
+
+    bool IsClose() const override
+    {
+        return m_is_close;
+    }
+
+    int Size() const override
+    {
+        return m_size;
+    }
+
+ private:
+    struct Item
+    {
+        int64_t rank;
+        int64_t seq;
+        T elem;
+
+        bool operator<(const Item &other) const // reversed for std::priority_queue, which pops the largest
+        {
+            return rank != other.rank ? rank > other.rank : seq > other.seq;
+        }
+    };
+
+    int SizeLocked() const { return m_front.size() + m_heap.size(); }
+
+    void PopLocked(T &elem)
+    {
+        if (!m_front.empty()) {
+            elem = std::move(m_front.front());
+            m_front.pop_front();
+        } else {
+            // top() is const, heap order only looks at rank and seq, so moving elem out before pop is safe
+            elem = std::move(const_cast<Item &>(m_heap.top()).elem);
+            m_heap.pop();
+        }
+    }
+
+ private:
+    std::priority_queue<Item> m_heap;
+    std::deque<T> m_front;
+    int m_capacity;
+    int m_max_overtake;
+    int64_t m_seq;
+    std::atomic<int> m_size;
+    std::mutex m_mutex;
+    std::condition_variable m_push_cond;
+    std::condition_variable m_pop_cond;
+    std::atomic<bool> m_is_close;
+};
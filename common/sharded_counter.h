@@ -0,0 +1,80 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+// Counter for values updated by many threads and read rarely.
+// Each thread adds to its own shard on a separate cache line, Sum() adds up all shards.
+// Shards are allocated apart from the counter and aligned by hand, as counters may live in objects
+// from plain new, which doesn't align beyond alignof(std::max_align_t) before C++17.
+class ShardedCounter
+{
+ public:
+    ShardedCounter(int64_t value = 0)
+        : m_storage(new char[sizeof(Shard) * k_num_shards + k_cache_line_size])
+    {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(m_storage.get());
+        addr = (addr + k_cache_line_size - 1) & ~(uintptr_t)(k_cache_line_size - 1);
+        m_shards = reinterpret_cast<Shard*>(addr);
+        for (int i = 0; i < k_num_shards; ++i) {
+            new (&m_shards[i]) Shard;
+            m_shards[i].value = 0;
+        }
+        m_shards[0].value = value;
+    }
+
+    ShardedCounter(const ShardedCounter &) = delete;
+    ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+    void Add(int64_t v) { m_shards[ShardId()].value.fetch_add(v, std::memory_order_relaxed); }
+    void Sub(int64_t v) { m_shards[ShardId()].value.fetch_sub(v, std::memory_order_relaxed); }
+
+    int64_t Sum() const
+    {
+        int64_t sum = 0;
+        for (int i = 0; i < k_num_shards; ++i) {
+            sum += m_shards[i].value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+ private:
+    static int ShardId()
+    {
+        static std::atomic<int> next_id(0);
+        thread_local int id = next_id++ % k_num_shards;
+        return id;
+    }
+
+ private:
+    static const int k_num_shards = 32;
+    static const int k_cache_line_size = 64;
+
+    struct alignas(k_cache_line_size) Shard
+    {
+        std::atomic<int64_t> value;
+    };
+    static_assert(sizeof(Shard) == k_cache_line_size, "a shard should take exactly one cache line");
+
+    std::unique_ptr<char[]> m_storage;
+    Shard *m_shards;
+};
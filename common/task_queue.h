@@ -18,13 +18,41 @@
 #pragma once
 
 #include <deque>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
 
+// Interface of task queues, for users choosing the implementation at runtime.
 template<class T>
-class TaskQueue
+class TaskQueueBase
+{
+ public:
+    virtual ~TaskQueueBase() {}
+
+    // blocks while queue is full, returns false if queue is closed, elem is left to the caller then
+    virtual bool Push(T &&elem) = 0;
+
+    // elem is popped before queued ones, ignores capacity
+    virtual void PushFront(T elem) = 0;
+
+    // waits timeout_us at most, forever if < 0, returns false if timeout or closed
+    virtual bool Pop(T &elem, int64_t timeout_us = -1) = 0;
+
+    // Waits for the first elem as Pop(elem, -1), then appends more to elems until max_num are popped
+    // or batch_timeout_us passed since the first. Returns number popped, 0 only if closed.
+    virtual int PopBatch(std::vector<T> &elems, int max_num, int64_t batch_timeout_us) = 0;
+
+    virtual void Close() = 0;
+
+    virtual bool IsClose() const = 0;
+
+    virtual int Size() const = 0;
+};
+
+template<class T>
+class TaskQueue: public TaskQueueBase<T>
 {
  public:
     TaskQueue(int capacity = 0)
@@ -32,30 +60,32 @@ class TaskQueue
     {
     }
 
-    template<class U>
-    void Push(U &&elem)
+    bool Push(T &&elem) override
     {
         std::unique_lock<std::mutex> lock(m_mutex);
         if (m_capacity > 0) {
-            m_push_cond.wait(lock, [this]{ return m_queue.size() < m_capacity; });
+            m_push_cond.wait(lock, [this]{ return m_queue.size() < m_capacity || m_is_close; });
         }
-        m_queue.push_back(std::forward<U>(elem));
+        if (m_is_close) {
+            return false;
+        }
+        m_queue.push_back(std::move(elem));
         m_size = m_queue.size();
         lock.unlock();
         m_pop_cond.notify_one();
+        return true;
     }
 
-    template<class U>
-    void PushFront(U &&elem)
+    void PushFront(T elem) override
     {
         std::unique_lock<std::mutex> lock(m_mutex);
-        m_queue.push_front(std::forward<U>(elem));
+        m_queue.push_front(std::move(elem));
         m_size = m_queue.size();
         lock.unlock();
         m_pop_cond.notify_one();
     }
 
-    bool Pop(T &elem, int64_t timeout_us = -1)
+    bool Pop(T &elem, int64_t timeout_us = -1) override
     {
         std::unique_lock<std::mutex> lock(m_mutex);
         if (timeout_us < 0) {
@@ -79,7 +109,31 @@ class TaskQueue
         return true;
     }
 
-    void Close()
+    int PopBatch(std::vector<T> &elems, int max_num, int64_t batch_timeout_us) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pop_cond.wait(lock, [this]{ return !m_queue.empty() || m_is_close; });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(batch_timeout_us);
+        int num = 0;
+        for (;;) {
+            for (; num < max_num && !m_queue.empty(); ++num) {
+                elems.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+            if (num == max_num || m_is_close ||
+                !m_pop_cond.wait_until(lock, deadline, [this]{ return !m_queue.empty() || m_is_close; })) {
+                break;
+            }
+        }
+        m_size = m_queue.size();
+        lock.unlock();
+        if (m_capacity > 0 && num > 0) {
+            m_push_cond.notify_all();
+        }
+        return num;
+    }
+
+    void Close() override
     {
         {
             std::lock_guard<std::mutex> lock(m_mutex);
@@ -89,12 +143,12 @@ class TaskQueue
         m_pop_cond.notify_all();
     }
 
-    bool IsClose() const
+    bool IsClose() const override
     {
         return m_is_close;
     }
 
-    int Size() const
+    int Size() const override
     {
         return m_size;
     }
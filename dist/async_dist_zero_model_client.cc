@@ -50,6 +50,8 @@ AsyncDistZeroModelClient::~AsyncDistZeroModelClient()
 
 int AsyncDistZeroModelClient::Init(const ModelConfig &model_config)
 {
+    InitBoardSize(model_config);
+
     AsyncRpcQueue queue;
     InitReq req;
     req.mutable_model_config()->CopyFrom(model_config);
@@ -109,20 +111,43 @@ int AsyncDistZeroModelClient::GetGlobalStep(int &global_step)
 
 void AsyncDistZeroModelClient::Forward(const std::vector<std::vector<bool>> &inputs, callback_t callback)
 {
-    int stub_id = GetStub();
     ForwardReq req;
     for (const auto &features: inputs) {
-        if (features.size() != INPUT_DIM) {
-            LOG(ERROR) << "Error input dim not match, need " << INPUT_DIM << ", got " << features.size();
+        if ((int)features.size() != InputDim()) {
+            LOG(ERROR) << "Error input dim not match, need " << InputDim() << ", got " << features.size();
             callback(ERR_INVALID_INPUT, {}, {});
             return;
         }
-        std::string encode_features((INPUT_DIM + 7) / 8, 0);
-        for (int i = 0; i < INPUT_DIM; ++i) {
+        std::string encode_features((InputDim() + 7) / 8, 0);
+        for (int i = 0; i < InputDim(); ++i) {
             encode_features[i / 8] |= (unsigned char)features[i] << (i % 8);
         }
         req.add_inputs(encode_features);
     }
+    ForwardRpc(req, callback);
+}
+
+void AsyncDistZeroModelClient::Forward(const std::vector<const PackedFeatures *> &inputs, callback_t callback)
+{
+    ForwardReq req;
+    if (!m_config.enable_packed_inputs()) {
+        for (const PackedFeatures *features: inputs) {
+            features->UnpackBits(BoardSize(), req.add_inputs());
+        }
+        ForwardRpc(req, callback);
+        return;
+    }
+    std::string *packed_inputs = req.mutable_packed_inputs();
+    packed_inputs->reserve(inputs.size() * sizeof(PackedFeatures));
+    for (const PackedFeatures *features: inputs) {
+        packed_inputs->append((const char *)features, sizeof(PackedFeatures));
+    }
+    ForwardRpc(req, callback);
+}
+
+void AsyncDistZeroModelClient::ForwardRpc(const ForwardReq &req, callback_t callback)
+{
+    int stub_id = GetStub();
     m_forward_rpc_queue.Call<ForwardReq, ForwardResp>(
         BindAsyncRpcFunc(*m_stubs[stub_id], AsyncForward), req,
         [this, stub_id, callback](grpc::Status &status, ForwardResp &resp) {
@@ -179,6 +204,18 @@ int AsyncDistZeroModelClient::Forward(const std::vector<std::vector<bool>> &inpu
     return ret;
 }
 
+int AsyncDistZeroModelClient::Forward(const std::vector<const PackedFeatures *> &inputs,
+                                      std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    std::promise<std::tuple<int, std::vector<std::vector<float>>, std::vector<float>>> promise;
+    Forward(inputs, [&promise](int ret, std::vector<std::vector<float>> policy, std::vector<float> value) {
+        promise.set_value(std::make_tuple(ret, std::move(policy), std::move(value)));
+    });
+    int ret;
+    std::tie(ret, policy, value) = promise.get_future().get();
+    return ret;
+}
+
 int AsyncDistZeroModelClient::RpcQueueSize()
 {
     return m_forward_rpc_queue.Size();
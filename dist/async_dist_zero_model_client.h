@@ -44,6 +44,11 @@ class AsyncDistZeroModelClient final : public ZeroModelBase
 
     void Forward(const std::vector<std::vector<bool>> &inputs, callback_t callback) override;
 
+    int Forward(const std::vector<const PackedFeatures *> &inputs,
+                std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
+
+    void Forward(const std::vector<const PackedFeatures *> &inputs, callback_t callback) override;
+
     int GetGlobalStep(int &global_step) override;
 
     int RpcQueueSize() override;
@@ -51,6 +56,8 @@ class AsyncDistZeroModelClient final : public ZeroModelBase
     void Wait() override;
 
  private:
+    void ForwardRpc(const ForwardReq &req, callback_t callback);
+
     int GetStub();
 
     void ReleaseStub(int stub_id);
@@ -32,6 +32,8 @@ DistZeroModelClient::DistZeroModelClient(const std::string &server_address, cons
 
 int DistZeroModelClient::Init(const ModelConfig &model_config)
 {
+    InitBoardSize(model_config);
+
     InitReq req;
     InitResp resp;
 
@@ -71,20 +73,44 @@ int DistZeroModelClient::Forward(const std::vector<std::vector<bool>>& inputs,
                                  std::vector<std::vector<float>> &policy, std::vector<float> &value)
 {
     ForwardReq req;
-    ForwardResp resp;
 
     for (const auto &features: inputs) {
-        if (features.size() != INPUT_DIM) {
-            LOG(ERROR) << "Error input dim not match, need " << INPUT_DIM << ", got " << features.size();
+        if ((int)features.size() != InputDim()) {
+            LOG(ERROR) << "Error input dim not match, need " << InputDim() << ", got " << features.size();
             return ERR_INVALID_INPUT;
         }
-        std::string encode_features((INPUT_DIM + 7) / 8, 0);
-        for (int i = 0; i < INPUT_DIM; ++i) {
+        std::string encode_features((InputDim() + 7) / 8, 0);
+        for (int i = 0; i < InputDim(); ++i) {
             encode_features[i / 8] |= (unsigned char)features[i] << (i % 8);
         }
         req.add_inputs(encode_features);
     }
 
+    return ForwardRpc(req, policy, value);
+}
+
+int DistZeroModelClient::Forward(const std::vector<const PackedFeatures *> &inputs,
+                                 std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    ForwardReq req;
+    if (!m_config.enable_packed_inputs()) {
+        for (const PackedFeatures *features: inputs) {
+            features->UnpackBits(BoardSize(), req.add_inputs());
+        }
+        return ForwardRpc(req, policy, value);
+    }
+    std::string *packed_inputs = req.mutable_packed_inputs();
+    packed_inputs->reserve(inputs.size() * sizeof(PackedFeatures));
+    for (const PackedFeatures *features: inputs) {
+        packed_inputs->append((const char *)features, sizeof(PackedFeatures));
+    }
+    return ForwardRpc(req, policy, value);
+}
+
+int DistZeroModelClient::ForwardRpc(const ForwardReq &req,
+                                    std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    ForwardResp resp;
     grpc::ClientContext context;
     if (m_config.timeout_ms() > 0) {
         context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(m_config.timeout_ms()));
@@ -35,10 +35,18 @@ class DistZeroModelClient final : public ZeroModelBase
     int Forward(const std::vector<std::vector<bool>>& inputs,
                 std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
 
+    int Forward(const std::vector<const PackedFeatures *> &inputs,
+                std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
+
+    using ZeroModelBase::Forward;
+
     int GetGlobalStep(int &global_step) override;
 
     void Wait() override;
 
+ private:
+    int ForwardRpc(const ForwardReq &req, std::vector<std::vector<float>> &policy, std::vector<float> &value);
+
  private:
     DistConfig m_config;
     std::string m_server_address;
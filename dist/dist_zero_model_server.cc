@@ -15,6 +15,8 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstring>
+
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include <grpc++/grpc++.h>
@@ -87,24 +89,44 @@ class DistZeroModelServiceImpl final : public DistZeroModel::Service
             return grpc::Status(grpc::StatusCode(-1), "DistZeroModel hasn't init");
         }
 
-        std::vector<std::vector<bool>> inputs;
-        for (const auto &encode_features: req->inputs()) {
-            if ((int)encode_features.size() * 8 < m_model->INPUT_DIM) {
-                LOG(ERROR) << "Error input features need " << m_model->INPUT_DIM << " bits, recv only "
-                           << encode_features.size() * 8;
+        std::vector<std::vector<float>> policy;
+        std::vector<float> value;
+        int batch_size;
+        int ret;
+        if (!req->packed_inputs().empty()) {
+            const std::string &packed_inputs = req->packed_inputs();
+            if (packed_inputs.size() % sizeof(PackedFeatures) != 0) {
+                LOG(ERROR) << "Error packed inputs size " << packed_inputs.size()
+                           << " is not a multiple of " << sizeof(PackedFeatures);
                 return grpc::Status(grpc::StatusCode(ERR_INVALID_INPUT), "Forward error");
             }
-            std::vector<bool> features(m_model->INPUT_DIM);
-            for (int i = 0; i < m_model->INPUT_DIM; ++i) {
-                features[i] = (unsigned char)encode_features[i / 8] >> (i % 8) & 1;
+            // copied out for alignment of uint64 words
+            std::vector<PackedFeatures> features(packed_inputs.size() / sizeof(PackedFeatures));
+            memcpy(features.data(), packed_inputs.data(), packed_inputs.size());
+            std::vector<const PackedFeatures *> inputs;
+            for (const auto &f: features) {
+                inputs.push_back(&f);
+            }
+            batch_size = inputs.size();
+            ret = m_model->Forward(inputs, policy, value);
+        } else {
+            std::vector<std::vector<bool>> inputs;
+            for (const auto &encode_features: req->inputs()) {
+                if ((int)encode_features.size() * 8 < m_model->InputDim()) {
+                    LOG(ERROR) << "Error input features need " << m_model->InputDim() << " bits, recv only "
+                               << encode_features.size() * 8;
+                    return grpc::Status(grpc::StatusCode(ERR_INVALID_INPUT), "Forward error");
+                }
+                std::vector<bool> features(m_model->InputDim());
+                for (int i = 0; i < m_model->InputDim(); ++i) {
+                    features[i] = (unsigned char)encode_features[i / 8] >> (i % 8) & 1;
+                }
+                inputs.push_back(std::move(features));
             }
-            inputs.push_back(std::move(features));
+            batch_size = inputs.size();
+            ret = m_model->Forward(inputs, policy, value);
         }
 
-        std::vector<std::vector<float>> policy;
-        std::vector<float> value;
-        int ret = m_model->Forward(inputs, policy, value);
-
         if (ret == 0) {
             for (size_t i = 0; i < policy.size(); ++i) {
                 auto *output = resp->add_outputs();
@@ -113,7 +135,7 @@ class DistZeroModelServiceImpl final : public DistZeroModel::Service
                 }
                 output->set_value(value[i]);
             }
-            if (resp->outputs_size() == 0) LOG(ERROR) << "input batch size " << inputs.size() << ", output 0!!!";
+            if (resp->outputs_size() == 0) LOG(ERROR) << "input batch size " << batch_size << ", output 0!!!";
             LOG_EVERY_N(INFO, 1000) << "Forward succ.";
             return grpc::Status::OK;
         } else {
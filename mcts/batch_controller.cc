@@ -0,0 +1,128 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "batch_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const int k_warmup_forwards = 8;
+static const int k_explore_every = 16;
+static const double k_forward_decay = 0.05;
+static const double k_arrival_decay = 0.2;
+static const int64_t k_min_arrival_sample_us = 1000;
+static const double k_wait_slack = 1.5; // arrivals are bursty, give the expected wait some slack
+
+BatchController::BatchController(int max_batch_size, int num_eval_threads, int64_t default_wait_us, float max_latency_ms)
+    : m_max_batch_size(std::max(max_batch_size, 1)),
+      m_num_eval_threads(std::max(num_eval_threads, 1)),
+      m_default_wait_us(default_wait_us),
+      m_max_latency_us(max_latency_ms * 1000.0),
+      m_last_arrivals(0),
+      m_arrival_rate(0.0),
+      m_num_plans(0),
+      m_num_forwards(0),
+      m_sx(0.0), m_sy(0.0), m_sxx(0.0), m_sxy(0.0),
+      m_fixed_us(0.0), m_per_task_us(0.0)
+{
+}
+
+void BatchController::Plan(int64_t arrivals, int queue_size, int &batch_size, int64_t &wait_us)
+{
+    UpdateArrivalRate(arrivals);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int plan = m_num_plans++;
+    if (m_num_forwards < k_warmup_forwards) {
+        // from the largest size down to 1, a fixed size would leave per task cost unknown
+        batch_size = m_max_batch_size - plan % k_warmup_forwards * (m_max_batch_size - 1) / (k_warmup_forwards - 1);
+        wait_us = m_default_wait_us;
+        return;
+    }
+
+    double rate = m_arrival_rate / m_num_eval_threads; // share of this thread
+    int queued = std::max(queue_size, 1); // the first task is waited for anyway
+    double max_wait_us = ForwardUs(m_max_batch_size);
+    double best_throughput = 0.0;
+    double best_wait_us = 0.0;
+    batch_size = 1;
+    for (int b = 1; b <= m_max_batch_size; ++b) {
+        double wait = b <= queued ? 0.0 : (rate > 0.0 ? (b - queued) / rate : INFINITY);
+        if (wait > max_wait_us) {
+            break;
+        }
+        double latency = wait + ForwardUs(b);
+        if (m_max_latency_us > 0.0 && latency > m_max_latency_us && b > 1) {
+            break;
+        }
+        double throughput = b / std::max(latency, 1.0);
+        if (throughput > best_throughput) {
+            best_throughput = throughput;
+            best_wait_us = wait;
+            batch_size = b;
+        }
+    }
+    wait_us = std::min(best_wait_us * k_wait_slack, max_wait_us);
+
+    // the best size is mostly the same, try half or twice of it now and then to keep the fit fresh
+    if (plan % k_explore_every == 0 && m_max_batch_size > 1) {
+        batch_size = batch_size * 2 <= m_max_batch_size ? batch_size * 2 : std::max(batch_size / 2, 1);
+        double wait = batch_size <= queued ? 0.0 : (rate > 0.0 ? (batch_size - queued) / rate : INFINITY);
+        wait_us = std::min(wait * k_wait_slack, max_wait_us);
+    }
+}
+
+void BatchController::OnForward(int batch_size, float cost_ms)
+{
+    double x = batch_size, y = cost_ms * 1000.0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double w = m_num_forwards ? k_forward_decay : 1.0;
+    ++m_num_forwards;
+    m_sx += w * (x - m_sx);
+    m_sy += w * (y - m_sy);
+    m_sxx += w * (x * x - m_sxx);
+    m_sxy += w * (x * y - m_sxy);
+
+    double var = m_sxx - m_sx * m_sx;
+    if (var > 0.25) {
+        m_per_task_us = std::max((m_sxy - m_sx * m_sy) / var, 0.0);
+        m_fixed_us = m_sy - m_per_task_us * m_sx;
+        if (m_fixed_us < 0.0) { // not linear, charge all cost to tasks
+            m_fixed_us = 0.0;
+            m_per_task_us = m_sy / m_sx;
+        }
+    } else { // batch size hardly changes lately, keep the per task cost fitted before
+        m_fixed_us = std::max(m_sy - m_per_task_us * m_sx, 0.0);
+    }
+}
+
+void BatchController::UpdateArrivalRate(int64_t arrivals)
+{
+    int64_t elapsed_us = m_arrival_timer.us();
+    if (elapsed_us < k_min_arrival_sample_us) {
+        return;
+    }
+    double rate = (double)(arrivals - m_last_arrivals) / elapsed_us;
+    m_arrival_rate = m_last_arrivals ? m_arrival_rate + k_arrival_decay * (rate - m_arrival_rate) : rate;
+    m_last_arrivals = arrivals;
+    m_arrival_timer.Reset();
+}
+
+double BatchController::ForwardUs(int batch_size) const
+{
+    return m_fixed_us + m_per_task_us * batch_size;
+}
@@ -0,0 +1,62 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "common/timer.h"
+
+// Chooses batch size and batch wait of an eval thread online, instead of fixed eval_batch_size and
+// eval_wait_batch_timeout_us. It watches the arrival rate of eval tasks, the queue depth and the forward
+// latency, fitted as fixed cost + per task cost of batch size. A batch of b tasks costs the wait for tasks
+// not queued yet plus its forward, the batch size maximizing b / cost within the latency bound is taken.
+// Waiting for a batch is never longer than a forward of the largest batch. Warm up batches spread over all
+// sizes and later one plan in k_explore_every tries another size, so that the per task cost can be fitted.
+class BatchController
+{
+ public:
+    BatchController(int max_batch_size, int num_eval_threads, int64_t default_wait_us, float max_latency_ms);
+
+    // arrivals: eval tasks pushed so far by all search threads, queue_size: tasks waiting in queue
+    void Plan(int64_t arrivals, int queue_size, int &batch_size, int64_t &wait_us);
+
+    // called when a forward is done, maybe from a rpc thread
+    void OnForward(int batch_size, float cost_ms);
+
+ private:
+    void UpdateArrivalRate(int64_t arrivals);
+    double ForwardUs(int batch_size) const; // holding m_mutex
+
+ private:
+    int m_max_batch_size;
+    int m_num_eval_threads;
+    int64_t m_default_wait_us;
+    double m_max_latency_us;
+
+    Timer m_arrival_timer;
+    int64_t m_last_arrivals;
+    double m_arrival_rate; // tasks per us of all eval threads
+
+    std::mutex m_mutex;
+    int m_num_plans;
+    int m_num_forwards;
+    // weighted moving averages of batch size x and forward cost y (us), for least squares of y = a + c * x
+    double m_sx, m_sy, m_sxx, m_sxy;
+    double m_fixed_us, m_per_task_us;
+};
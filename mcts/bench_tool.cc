@@ -0,0 +1,352 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+
+#include "common/go_state.h"
+#include "common/str_utils.h"
+#include "common/timer.h"
+
+#include "puct.h"
+#include "tree_node.h"
+#include "tree_node_arena.h"
+
+DEFINE_string(bench, "puct", "Comma separated benchmarks to run: puct, scaling, score, gostate.");
+DEFINE_int32(num_iterations, 1000000, "How many iterations should run.");
+DEFINE_int32(num_children, 362, "Number of children of each node, for puct and scaling.");
+DEFINE_int32(seed, 0, "Random seed.");
+DEFINE_string(search_threads, "1,2,4,8,16", "Comma separated num_search_threads to run, for scaling.");
+DEFINE_int32(padded_depth, 1, "node_layout.padded_depth compared with unpadded layout, for scaling.");
+
+void BenchPuct()
+{
+    const int num_nodes = 64;
+    std::minstd_rand rand(FLAGS_seed);
+    std::vector<PuctStats> nodes(num_nodes);
+    std::vector<float> sqrt_sigmas(num_nodes);
+    for (int n = 0; n < num_nodes; ++n) {
+        PuctStats &s = nodes[n];
+        s.size = std::min(FLAGS_num_children, PuctStats::k_capacity);
+        std::exponential_distribution<float> prior(1.0f);
+        std::geometric_distribution<int> visit(0.05);
+        std::uniform_real_distribution<float> q(-1.0f, 1.0f);
+        float prior_sum = 0.0f, sigma = 0.0f;
+        for (int i = 0; i < s.size; ++i) {
+            s.prior_prob[i] = prior(rand);
+            prior_sum += s.prior_prob[i];
+            s.visit_count[i] = rand() % 3 ? 0 : visit(rand);
+            s.virtual_loss[i] = rand() % 8 ? 0 : rand() % 4;
+            s.total_action[i] = s.visit_count[i] * q(rand);
+            sigma += s.visit_count[i] + s.virtual_loss[i];
+        }
+        for (int i = 0; i < s.size; ++i) {
+            s.prior_prob[i] /= prior_sum;
+        }
+        s.PadTail();
+        sqrt_sigmas[n] = std::max(std::sqrt(sigma), 1.0f);
+    }
+
+    for (int mode = 0; mode < 4; ++mode) {
+        for (int i = 0; i < num_nodes; ++i) {
+            float score, scalar_score;
+            int best = PuctSelect(nodes[i], mode, 2.5f, sqrt_sigmas[i], 0.0f, score);
+            int scalar_best = PuctSelectScalar(nodes[i], mode, 2.5f, sqrt_sigmas[i], 0.0f, scalar_score);
+            CHECK(best == scalar_best && score == scalar_score)
+                << "BenchPuct: result mismatch, mode " << mode << ", node " << i
+                << ", simd " << best << "/" << score << ", scalar " << scalar_best << "/" << scalar_score;
+        }
+
+        int64_t checksum = 0;
+        float score;
+        Timer timer;
+        for (int i = 0; i < FLAGS_num_iterations; ++i) {
+            int n = i % num_nodes;
+            checksum += PuctSelectScalar(nodes[n], mode, 2.5f, sqrt_sigmas[n], 0.0f, score);
+        }
+        float scalar_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+        timer.Reset();
+        for (int i = 0; i < FLAGS_num_iterations; ++i) {
+            int n = i % num_nodes;
+            checksum -= PuctSelect(nodes[n], mode, 2.5f, sqrt_sigmas[n], 0.0f, score);
+        }
+        float simd_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+        CHECK_EQ(checksum, 0);
+
+        LOG(INFO) << "BenchPuct: virtual_loss_mode " << mode << ", " << nodes[0].size << " children, scalar "
+                  << scalar_ns << "ns, simd " << simd_ns << "ns per select, speedup " << scalar_ns / simd_ns;
+    }
+}
+
+// Two levels of fully expanded tree laid out as MCTSEngine does, nodes at depth <= padded_depth are padded.
+// Leaves are never expanded, so a simulation is select, virtual loss and backup only, which are the parts
+// contending on the shared nodes near the root.
+class ScalingTree
+{
+ public:
+    ScalingTree(int num_children, int padded_depth)
+        : m_num_children(num_children)
+    {
+        m_root = m_arena.Get(m_arena.Allocate(1));
+        InitNode(m_root, 0);
+        Expand(m_root, 1, padded_depth);
+        TreeNode *ch[GoComm::GOBOARD_SIZE + 1];
+        for (int i = 0; i < GetChildren(m_root, ch); ++i) {
+            Expand(ch[i], 2, padded_depth);
+        }
+    }
+
+    void Simulate(std::minstd_rand &rand)
+    {
+        TreeNode *path[3] = {m_root};
+        m_root->AddVirtualLoss();
+        for (int d = 1; d < 3; ++d) {
+            path[d] = SelectChild(path[d - 1]);
+            path[d]->AddVirtualLoss();
+        }
+        float value = std::uniform_real_distribution<float>(-1.0f, 1.0f)(rand);
+        for (int d = 2; d >= 0; --d, value = -value) {
+            path[d]->total_action += (int64_t)(value * k_action_value_base);
+            path[d]->AddVisit();
+        }
+    }
+
+    int64_t RootVisitCount() const { return m_root->VisitCount(); }
+
+ private:
+    static void InitNode(TreeNode *node, int move)
+    {
+        node->count = 0;
+        node->total_action = 0;
+        node->fa = 0;
+        node->ch = 0;
+        node->SetExpandState(k_unexpanded);
+        node->move = move;
+        node->SetPriorProb(0.0f);
+        node->SetValue(0.0f);
+    }
+
+    void Expand(TreeNode *node, int ch_depth, int padded_depth)
+    {
+        bool padded = ch_depth <= padded_depth;
+        int stride = padded ? 2 : 1;
+        uint32_t ch_index = padded ? m_arena.AllocatePadded(m_num_children) : m_arena.Allocate(m_num_children);
+        TreeNode *ch = m_arena.Get(ch_index);
+        std::minstd_rand rand(ch_index);
+        std::exponential_distribution<float> prior(1.0f);
+        float prior_sum = 0.0f;
+        float priors[GoComm::GOBOARD_SIZE + 1];
+        for (int i = 0; i < m_num_children; ++i) {
+            priors[i] = prior(rand);
+            prior_sum += priors[i];
+        }
+        for (int i = 0; i < m_num_children; ++i) {
+            InitNode(&ch[i * stride], i);
+            ch[i * stride].SetPriorProb(priors[i] / prior_sum);
+        }
+        node->ch = ch_index;
+        node->SetExpandState(k_expanded, m_num_children, padded ? TreeNode::k_padded_flag : 0);
+    }
+
+    int GetChildren(TreeNode *node, TreeNode **ch)
+    {
+        TreeNode *block = m_arena.Get(node->ch);
+        int stride = node->ChStride();
+        for (int i = 0; i < node->ChLen(); ++i) {
+            ch[i] = &block[i * stride];
+        }
+        return node->ChLen();
+    }
+
+    TreeNode *SelectChild(TreeNode *node)
+    {
+        TreeNode *ch[GoComm::GOBOARD_SIZE + 1];
+        int ch_len = GetChildren(node, ch);
+        PuctStats stats;
+        float sigma = 0.0f;
+        for (int i = 0; i < ch_len; ++i) {
+            uint64_t count = ch[i]->count;
+            stats.visit_count[i] = TreeNode::VisitCount(count);
+            stats.virtual_loss[i] = TreeNode::VirtualLossCount(count);
+            stats.total_action[i] = (float)ch[i]->total_action / k_action_value_base;
+            stats.prior_prob[i] = ch[i]->PriorProb();
+            sigma += stats.visit_count[i] + stats.virtual_loss[i];
+        }
+        stats.size = ch_len;
+        stats.PadTail();
+        float best;
+        int best_i = PuctSelect(stats, 0, 2.5f, std::max(std::sqrt(sigma), 1.0f), 0.0f, best);
+        return ch[std::max(best_i, 0)];
+    }
+
+ private:
+    int m_num_children;
+    TreeNodeArena m_arena;
+    TreeNode *m_root;
+};
+
+float RunScaling(int num_threads, int padded_depth)
+{
+    ScalingTree tree(std::min(FLAGS_num_children, GoComm::GOBOARD_SIZE + 1), padded_depth);
+    int sims_per_thread = FLAGS_num_iterations / num_threads;
+    std::vector<std::thread> threads;
+    Timer timer;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&tree, sims_per_thread, t]() {
+            std::minstd_rand rand(FLAGS_seed + t);
+            for (int i = 0; i < sims_per_thread; ++i) {
+                tree.Simulate(rand);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    float cost_s = timer.fms() / 1000;
+    CHECK_EQ(tree.RootVisitCount(), (int64_t)sims_per_thread * num_threads);
+    return sims_per_thread * num_threads / cost_s;
+}
+
+void BenchScaling()
+{
+    float base[2] = {0.0f, 0.0f};
+    for (const std::string &threads_str: SplitStr(FLAGS_search_threads, ',')) {
+        int num_threads = std::stoi(threads_str);
+        CHECK_GT(num_threads, 0);
+        float unpadded = RunScaling(num_threads, 0);
+        float padded = RunScaling(num_threads, FLAGS_padded_depth);
+        if (base[0] == 0.0f) {
+            base[0] = unpadded;
+            base[1] = padded;
+        }
+        LOG(INFO) << "BenchScaling: num_search_threads " << num_threads
+                  << ", unpadded " << (int64_t)unpadded << " sims/s (x" << unpadded / base[0] << ")"
+                  << ", padded_depth " << FLAGS_padded_depth << " " << (int64_t)padded << " sims/s (x" << padded / base[1] << ")"
+                  << ", speedup " << padded / unpadded;
+    }
+}
+
+// Positions sampled from random games, from opening to filled board.
+std::vector<GoState> RandomPositions(int num_positions)
+{
+    std::minstd_rand rand(FLAGS_seed);
+    std::vector<GoState> positions;
+    GoSuperkoHistory superko_history;
+    GoState board;
+    board.SetSuperkoHistory(&superko_history);
+    int ply = 0;
+    while ((int)positions.size() < num_positions) {
+        int moves[GoComm::GOBOARD_SIZE], num_moves = 0;
+        for (int i = 0; i < GoComm::GOBOARD_SIZE; ++i) {
+            if (board.IsLegal(i)) moves[num_moves++] = i;
+        }
+        if (num_moves == 0 || ply >= 400) {
+            superko_history.Clear();
+            board.CopyFrom(GoState());
+            board.SetSuperkoHistory(&superko_history);
+            ply = 0;
+            continue;
+        }
+        CHECK_EQ(board.Move(moves[rand() % num_moves]), 0);
+        if (++ply % 25 == 0) {
+            positions.push_back(board);
+        }
+    }
+    return positions;
+}
+
+void BenchScore()
+{
+    std::vector<GoState> positions = RandomPositions(64);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        GoSize black, white, empty, scalar_black, scalar_white, scalar_empty;
+        GoSize score = positions[i].CalcScore(black, white, empty);
+        GoSize scalar_score = positions[i].CalcScoreScalar(scalar_black, scalar_white, scalar_empty);
+        CHECK(score == scalar_score && black == scalar_black && white == scalar_white)
+            << "BenchScore: result mismatch, position " << i << ", bitboard " << black << "/" << white
+            << ", scalar " << scalar_black << "/" << scalar_white;
+    }
+
+    int64_t checksum = 0;
+    GoSize black, white, empty;
+    Timer timer;
+    for (int i = 0; i < FLAGS_num_iterations; ++i) {
+        checksum += positions[i % positions.size()].CalcScoreScalar(black, white, empty);
+    }
+    float scalar_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+    timer.Reset();
+    for (int i = 0; i < FLAGS_num_iterations; ++i) {
+        checksum -= positions[i % positions.size()].CalcScore(black, white, empty);
+    }
+    float bitboard_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+    CHECK_EQ(checksum, 0);
+
+    LOG(INFO) << "BenchScore: " << positions.size() << " positions, scalar " << scalar_ns << "ns, bitboard "
+              << bitboard_ns << "ns per score, speedup " << scalar_ns / bitboard_ns;
+}
+
+void BenchGoState()
+{
+    std::vector<GoState> positions = RandomPositions(64);
+
+    uint64_t checksum = 0;
+    Timer timer;
+    for (int i = 0; i < FLAGS_num_iterations; ++i) {
+        GoState board(i & 1);
+        checksum += board.GetHashValue() + board.IsLegal(i % GoComm::GOBOARD_SIZE);
+    }
+    float construct_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+
+    GoState board;
+    timer.Reset();
+    for (int i = 0; i < FLAGS_num_iterations; ++i) {
+        board.CopyFrom(positions[i % positions.size()]);
+        checksum += board.GetHashValue();
+    }
+    float copy_ns = timer.fus() * 1000 / FLAGS_num_iterations;
+
+    LOG(INFO) << "BenchGoState: construct " << construct_ns << "ns, CopyFrom " << copy_ns
+              << "ns, sizeof(GoState) " << sizeof(GoState) << ", checksum " << checksum;
+}
+
+int main(int argc, char* argv[])
+{
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    google::InstallFailureSignalHandler();
+
+    for (const std::string &bench: SplitStr(FLAGS_bench, ',')) {
+        if (bench == "puct") {
+            BenchPuct();
+        } else if (bench == "scaling") {
+            BenchScaling();
+        } else if (bench == "score") {
+            BenchScore();
+        } else if (bench == "gostate") {
+            BenchGoState();
+        } else {
+            LOG(FATAL) << "Unknown benchmark '" << bench << "'";
+        }
+    }
+}
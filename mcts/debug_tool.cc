@@ -21,6 +21,7 @@
 #include "model/zero_model.h"
 #include "model/trt_zero_model.h"
 #include "common/go_state.h"
+#include "common/go_symmetry.h"
 #include "common/timer.h"
 
 #include "mcts_config.h"
@@ -34,7 +35,8 @@ DEFINE_int32(transform, 0, "Transform features.");
 DEFINE_int32(num_iterations, 1, "How many iterations should run.");
 DEFINE_int32(batch_size, 1, "Batch size of each iterations.");
 
-void InitMove(GoState& board, std::string& moves)
+template<int N>
+void InitMove(GoStateT<N>& board, std::string& moves)
 {
     for (size_t i = 0; i < moves.size(); i += 3) {
         int x = -1, y = -1;
@@ -46,34 +48,40 @@ void InitMove(GoState& board, std::string& moves)
     }
 }
 
-void TransformCoord(GoCoordId &x, GoCoordId &y, int mode, bool reverse)
+template<int N>
+void Run(ZeroModelBase *model)
 {
-    if (reverse) {
-        if (mode & 4) std::swap(x, y);
-        if (mode & 2) y = GoComm::BORDER_SIZE - y - 1;
-        if (mode & 1) x = GoComm::BORDER_SIZE - x - 1;
-    } else {
-        if (mode & 1) x = GoComm::BORDER_SIZE - x - 1;
-        if (mode & 2) y = GoComm::BORDER_SIZE - y - 1;
-        if (mode & 4) std::swap(x, y);
+    GoStateT<N> board;
+    GoSuperkoHistory superko_history;
+    board.SetSuperkoHistory(&superko_history);
+    InitMove(board, FLAGS_init_moves);
+
+    auto features = board.GetFeature();
+    GoSymmetry::TransformFeatures<N>(features, FLAGS_transform, false);
+    std::vector<std::vector<bool>> inputs(FLAGS_batch_size, features);
+
+    std::vector<std::vector<float>> policies;
+    std::vector<float> values;
+
+    Timer timer;
+    for (int i = 1; i <= FLAGS_num_iterations; ++i) {
+        CHECK_EQ(model->Forward(inputs, policies, values), 0) << "Forward fail";
+        LOG_IF(INFO, i % 100 == 0) << i << "/" << FLAGS_num_iterations << " iterations";
     }
-}
+    float avg_cost_ms = timer.fms() / FLAGS_num_iterations;
+    LOG(INFO) << "Cost " << avg_cost_ms << "ms per iteration";
 
-template<class T>
-void TransformFeatures(T &features, int mode, bool reverse)
-{
-    T ret(features.size());
-    int depth = features.size() / GoComm::GOBOARD_SIZE;
-    for (int i = 0; i < GoComm::GOBOARD_SIZE; ++i) {
-        GoCoordId x, y;
-        GoFunction::IdToCoord(i, x, y);
-        TransformCoord(x, y, mode, reverse);
-        int j = GoFunction::CoordToId(x, y);
-        for (int k = 0; k < depth; ++k) {
-            ret[i * depth + k] = features[j * depth + k];
+    std::vector<float>& policy = policies[0];
+    GoSymmetry::TransformFeatures<N>(policy, FLAGS_transform, true);
+    float value = values[0];
+    board.ShowBoard();
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            printf("%.4f ", policy[i * N + j]);
         }
+        puts("");
     }
-    features = std::move(ret);
+    printf("Value %.4f Pass %.4f\n", value, policy[N * N]);
 }
 
 int main(int argc, char* argv[])
@@ -85,6 +93,10 @@ int main(int argc, char* argv[])
     auto config = LoadConfig(FLAGS_config_path);
     CHECK(config != nullptr) << "Load mcts config file '" << FLAGS_config_path << "' failed";
 
+    if (config->board_size() > 0) {
+        config->mutable_model_config()->set_board_size(config->board_size());
+    }
+
     if (FLAGS_intra_op_parallelism_threads > 0) {
         config->mutable_model_config()->set_intra_op_parallelism_threads(FLAGS_intra_op_parallelism_threads);
     }
@@ -105,33 +117,10 @@ int main(int argc, char* argv[])
 #endif
     CHECK_EQ(model->Init(config->model_config()), 0) << "Model Init Fail, config path " << FLAGS_config_path<< ", gpu " << FLAGS_gpu;
 
-    GoState board;
-    InitMove(board, FLAGS_init_moves);
-
-    auto features = board.GetFeature();
-    TransformFeatures(features, FLAGS_transform, false);
-    std::vector<std::vector<bool>> inputs(FLAGS_batch_size, features);
-
-    std::vector<std::vector<float>> policies;
-    std::vector<float> values;
-
-    Timer timer;
-    for (int i = 1; i <= FLAGS_num_iterations; ++i) {
-        CHECK_EQ(model->Forward(inputs, policies, values), 0) << "Forward fail";
-        LOG_IF(INFO, i % 100 == 0) << i << "/" << FLAGS_num_iterations << " iterations";
-    }
-    float avg_cost_ms = timer.fms() / FLAGS_num_iterations;
-    LOG(INFO) << "Cost " << avg_cost_ms << "ms per iteration";
-
-    std::vector<float>& policy = policies[0];
-    TransformFeatures(policy, FLAGS_transform, true);
-    float value = values[0];
-    board.ShowBoard();
-    for (int i = 0; i < GoComm::BORDER_SIZE; ++i) {
-        for (int j = 0; j < GoComm::BORDER_SIZE; ++j) {
-            printf("%.4f ", policy[i * GoComm::BORDER_SIZE + j]);
-        }
-        puts("");
+    switch (model->BoardSize()) {
+        case 9:  Run<9>(model.get()); break;
+        case 13: Run<13>(model.get()); break;
+        case 19: Run<19>(model.get()); break;
+        default: LOG(FATAL) << "unsupported board_size " << model->BoardSize();
     }
-    printf("Value %.4f Pass %.4f\n", value, policy[361]);
 }
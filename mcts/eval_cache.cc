@@ -0,0 +1,71 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eval_cache.h"
+
+#include <glog/logging.h>
+
+#include "tree_node.h"
+
+EvalCache::EvalCache(int size, int num_stripes, int policy_size)
+    : m_entries(size),
+      m_num_stripes(num_stripes),
+      m_policy_size(policy_size),
+      m_mutexes(new std::mutex[num_stripes])
+{
+    CHECK_GT(size, 0) << "EvalCache: invalid size " << size;
+    CHECK_GT(num_stripes, 0) << "EvalCache: invalid num_stripes " << num_stripes;
+}
+
+void EvalCache::Insert(uint64_t key, const std::vector<float> &policy, float value)
+{
+    size_t slot = key % m_entries.size();
+    std::lock_guard<std::mutex> lock(GetMutex(slot));
+    Entry &entry = m_entries[slot];
+    entry.key = key;
+    entry.value = value;
+    entry.policy.clear(); // keep capacity for next insert
+    for (size_t i = 0; i < policy.size(); ++i) {
+        if (policy[i] > 0.0f) {
+            entry.policy.emplace_back(i, FloatToHalf(policy[i]));
+        }
+    }
+}
+
+bool EvalCache::Find(uint64_t key, std::vector<float> &policy, float &value)
+{
+    size_t slot = key % m_entries.size();
+    std::lock_guard<std::mutex> lock(GetMutex(slot));
+    const Entry &entry = m_entries[slot];
+    if (entry.policy.empty() || entry.key != key) {
+        return false;
+    }
+    policy.assign(m_policy_size, 0.0f);
+    for (const auto &p: entry.policy) {
+        policy[p.first] = HalfToFloat(p.second);
+    }
+    value = entry.value;
+    return true;
+}
+
+void EvalCache::Clear()
+{
+    for (size_t slot = 0; slot < m_entries.size(); ++slot) {
+        std::lock_guard<std::mutex> lock(GetMutex(slot));
+        m_entries[slot].policy.clear();
+    }
+}
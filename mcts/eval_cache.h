@@ -0,0 +1,55 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Results of recent evaluations, keyed by GoState::GetHistoryHashValue().
+// Direct mapped, slots are guarded by a fixed number of striped locks.
+// Policy is stored as fp16 and only for moves with non-zero probability.
+class EvalCache
+{
+ public:
+    EvalCache(int size, int num_stripes, int policy_size); // policy_size: board points + 1 for pass
+
+    void Insert(uint64_t key, const std::vector<float> &policy, float value);
+    bool Find(uint64_t key, std::vector<float> &policy, float &value);
+    void Clear();
+
+    int Size() const { return m_entries.size(); }
+
+ private:
+    struct Entry
+    {
+        uint64_t key;
+        float value;
+        std::vector<std::pair<uint16_t, uint16_t>> policy; // (move, fp16 prob), empty if slot unused
+    };
+
+    std::mutex &GetMutex(size_t slot) { return m_mutexes[slot % m_num_stripes]; }
+
+ private:
+    std::vector<Entry> m_entries;
+    int m_num_stripes;
+    int m_policy_size;
+    std::unique_ptr<std::mutex[]> m_mutexes;
+};
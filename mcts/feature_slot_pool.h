@@ -0,0 +1,101 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "model/zero_model_base.h"
+
+// Reusable model input buffers of eval tasks. Search threads write features of a leaf straight into a slot
+// and pass the slot along instead of the features, eval threads read it when assembling a batch.
+// Slots are cache line aligned and allocated by chunks, they are kept for reuse until the pool is destroyed.
+// Free slots are split into stripes, a thread reserves from its own stripe and a slot goes back to the stripe
+// it was reserved from, so search threads rarely contend with each other.
+class FeatureSlotPool
+{
+ public:
+    struct Slot
+    {
+        PackedFeatures features;
+        int stripe;
+    };
+
+    Slot *Reserve()
+    {
+        int stripe_id = StripeId();
+        Stripe &stripe = m_stripes[stripe_id];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        if (stripe.free.empty()) {
+            AllocateChunk(stripe_id, stripe.free);
+        }
+        Slot *slot = stripe.free.back();
+        stripe.free.pop_back();
+        return slot;
+    }
+
+    void Release(Slot *slot)
+    {
+        Stripe &stripe = m_stripes[slot->stripe];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.free.push_back(slot);
+    }
+
+ private:
+    static int StripeId()
+    {
+        static std::atomic<int> next_id(0);
+        thread_local int id = next_id++ % k_num_stripes;
+        return id;
+    }
+
+    void AllocateChunk(int stripe_id, std::vector<Slot *> &free)
+    {
+        const size_t stride = (sizeof(Slot) + k_cache_line_size - 1) / k_cache_line_size * k_cache_line_size;
+        char *chunk = new char[stride * k_chunk_slots + k_cache_line_size];
+        {
+            std::lock_guard<std::mutex> lock(m_chunks_mutex);
+            m_chunks.emplace_back(chunk);
+        }
+        char *base = chunk + (k_cache_line_size - (uintptr_t)chunk % k_cache_line_size) % k_cache_line_size;
+        for (int i = 0; i < k_chunk_slots; ++i) {
+            Slot *slot = new (base + i * stride) Slot;
+            slot->stripe = stripe_id;
+            free.push_back(slot);
+        }
+    }
+
+ private:
+    static const int k_num_stripes = 32;
+    static const int k_chunk_slots = 64;
+    static const int k_cache_line_size = 64;
+
+    struct Stripe
+    {
+        std::mutex mutex;
+        std::vector<Slot *> free;
+    };
+
+    Stripe m_stripes[k_num_stripes];
+    std::mutex m_chunks_mutex;
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+};
@@ -30,12 +30,14 @@
 
 #include "mcts_engine.h"
 
-MCTSDebugger::MCTSDebugger(MCTSEngine *engine)
+template<int N>
+MCTSDebugger<N>::MCTSDebugger(MCTSEngine<N> *engine)
     : m_engine(engine)
 {
 }
 
-void MCTSDebugger::Debug() // call before move
+template<int N>
+void MCTSDebugger<N>::Debug() // call before move
 {
     if (VLOG_IS_ON(1)) {
         int ith = m_engine->m_num_moves + 1;
@@ -52,19 +54,21 @@ void MCTSDebugger::Debug() // call before move
     }
 }
 
-std::string MCTSDebugger::GetDebugStr()
+template<int N>
+std::string MCTSDebugger<N>::GetDebugStr()
 {
     TreeNode *root = m_engine->m_root;
     int ith = m_engine->m_num_moves;
     std::string ith_str = std::to_string(ith) + "th move(" + "wb"[ith&1] + ")";
-    float root_action = (float)root->total_action / k_action_value_base / root->visit_count;
+    float root_action = (float)root->total_action / k_action_value_base / root->VisitCount();
     std::string debug_str =
-        ith_str + ": " + GoFunction::IdToStr(root->move) +
+        ith_str + ": " + GoBoard<N>::IdToStr(root->move) +
         ", winrate=" + std::to_string((root_action + 1) * 50) + "%" +
-        ", N=" + std::to_string(root->visit_count) +
+        ", N=" + std::to_string(root->VisitCount()) +
         ", Q=" + std::to_string(root_action) +
-        ", p=" + std::to_string(root->prior_prob) +
-        ", v=" + std::to_string(root->value);
+        ", p=" + std::to_string(root->PriorProb()) +
+        ", v=" + std::to_string(root->Value()) +
+        ", tree_size=" + std::to_string(m_engine->m_node_arena->NumAllocatedNodes());
     if (m_engine->m_simulation_counter > 0) {
         debug_str +=
             ", cost " + std::to_string(m_engine->m_search_timer.fms()) + "ms" +
@@ -76,35 +80,39 @@ std::string MCTSDebugger::GetDebugStr()
     return debug_str;
 }
 
-std::string MCTSDebugger::GetLastMoveDebugStr()
+template<int N>
+std::string MCTSDebugger<N>::GetLastMoveDebugStr()
 {
     return m_last_move_debug_str;
 }
 
-void MCTSDebugger::UpdateLastMoveDebugStr()
+template<int N>
+void MCTSDebugger<N>::UpdateLastMoveDebugStr()
 {
     m_last_move_debug_str = GetDebugStr();
 }
 
-std::string MCTSDebugger::GetMainMovePath(int rank)
+template<int N>
+std::string MCTSDebugger<N>::GetMainMovePath(int rank)
 {
     std::string moves;
     TreeNode *node = m_engine->m_root;
-    while (node->expand_state == k_expanded && node->ch_len > rank) {
-        TreeNode *ch = node->ch;
-        std::vector<int> idx(node->ch_len);
+    TreeNode *ch[GoBoard<N>::GOBOARD_SIZE + 1];
+    int ch_len;
+    while (node->ExpandState() == k_expanded && (ch_len = m_engine->GetChildren(node, ch)) > rank) {
+        std::vector<int> idx(ch_len);
         std::iota(idx.begin(), idx.end(), 0);
         std::nth_element(idx.begin(), idx.begin() + rank, idx.end(),
-                         [ch](int i, int j) { return ch[i].visit_count > ch[j].visit_count; });
-        TreeNode *best_ch = &ch[idx[rank]];
+                         [&ch](int i, int j) { return ch[i]->VisitCount() > ch[j]->VisitCount(); });
+        TreeNode *best_ch = ch[idx[rank]];
         if (moves.size()) moves += ",";
-        moves += GoFunction::IdToStr(best_ch->move);
+        moves += GoBoard<N>::IdToStr(best_ch->move);
         char buf[100];
         snprintf(buf, sizeof(buf), "(%d,%.2f,%.2f,%.2f)",
-                 best_ch->visit_count.load(),
-                 (float)best_ch->total_action / k_action_value_base / best_ch->visit_count,
-                 best_ch->prior_prob.load(),
-                 best_ch->value.load());
+                 best_ch->VisitCount(),
+                 (float)best_ch->total_action / k_action_value_base / best_ch->VisitCount(),
+                 best_ch->PriorProb(),
+                 best_ch->Value());
         moves += buf;
         node = best_ch;
         rank = 0;
@@ -112,8 +120,10 @@ std::string MCTSDebugger::GetMainMovePath(int rank)
     return moves;
 }
 
-void MCTSDebugger::PrintTree(int depth, int topk, const std::string &prefix)
+template<int N>
+void MCTSDebugger<N>::PrintTree(int depth, int topk, const std::string &prefix)
 {
+    TreeNodeArena *arena = m_engine->m_node_arena.get();
     TreeNode *root = m_engine->m_root;
     std::queue<std::pair<TreeNode*, int>> que;
     que.emplace(root, 1);
@@ -122,28 +132,33 @@ void MCTSDebugger::PrintTree(int depth, int topk, const std::string &prefix)
         std::tie(node, dep) = que.front();
         que.pop();
 
-        TreeNode *ch = node->ch;
-        std::vector<int> idx(node->ch_len);
+        TreeNode *ch[GoBoard<N>::GOBOARD_SIZE + 1];
+        std::vector<int> idx(m_engine->GetChildren(node, ch));
         std::iota(idx.begin(), idx.end(), 0);
-        std::sort(idx.begin(), idx.end(), [ch](int i, int j) { return ch[i].visit_count > ch[j].visit_count; });
+        std::sort(idx.begin(), idx.end(), [&ch](int i, int j) { return ch[i]->VisitCount() > ch[j]->VisitCount(); });
         if (topk < (int)idx.size()) idx.erase(idx.begin() + topk, idx.end());
 
         for (int i: idx) {
-            if (ch[i].visit_count == 0) {
+            int visit_count = ch[i]->VisitCount();
+            if (visit_count == 0) {
                 break;
             }
             std::string moves;
-            for (TreeNode *t = &ch[i]; t != root; t = t->fa) {
+            for (TreeNode *t = ch[i]; t != root; t = arena->Get(t->fa)) {
                 if (moves.size()) moves = "," + moves;
-                moves = GoFunction::IdToStr(t->move) + moves;
+                moves = GoBoard<N>::IdToStr(t->move) + moves;
             }
             VLOG(1) << prefix << moves
-                    << ": N=" << ch[i].visit_count
-                    << ", W=" << (float)ch[i].total_action / k_action_value_base
-                    << ", Q=" << (float)ch[i].total_action / k_action_value_base / ch[i].visit_count
-                    << ", p=" << ch[i].prior_prob
-                    << ", v=" << ch[i].value;
-            if (dep < depth) que.emplace(&ch[i], dep + 1);
+                    << ": N=" << visit_count
+                    << ", W=" << (float)ch[i]->total_action / k_action_value_base
+                    << ", Q=" << (float)ch[i]->total_action / k_action_value_base / visit_count
+                    << ", p=" << ch[i]->PriorProb()
+                    << ", v=" << ch[i]->Value();
+            if (dep < depth) que.emplace(ch[i], dep + 1);
         }
     }
 }
+
+#define MCTS_DEBUGGER_INSTANTIATE(n) template class MCTSDebugger<n>;
+FOR_EACH_BOARD_SIZE(MCTS_DEBUGGER_INSTANTIATE)
+#undef MCTS_DEBUGGER_INSTANTIATE
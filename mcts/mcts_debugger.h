@@ -19,11 +19,12 @@
 
 #include <string>
 
-class MCTSEngine;
+template<int N> class MCTSEngine;
+template<int N>
 class MCTSDebugger
 {
  public:
-    MCTSDebugger(MCTSEngine *engine);
+    MCTSDebugger(MCTSEngine<N> *engine);
 
     void Debug(); // call before move
 
@@ -35,6 +36,6 @@ class MCTSDebugger
     void PrintTree(int depth, int topk, const std::string &prefix = "");
 
  private:
-    MCTSEngine *m_engine;
+    MCTSEngine<N> *m_engine;
     std::string m_last_move_debug_str;
 };
@@ -19,6 +19,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <bitset>
 #include <numeric>
 #include <random>
 
@@ -32,20 +33,58 @@
 
 static thread_local std::random_device g_random_device;
 static thread_local std::minstd_rand g_random_engine(g_random_device());
+static thread_local int g_tree_size_check_counter = 0;
 
-MCTSEngine::MCTSEngine(const MCTSConfig &config)
+static const int k_delete_refill_period_ms = 10;
+static const int k_delete_nodes_per_token = 64;
+static const size_t k_delete_split_blocks = 256;
+static const int k_gc_num_buckets = 33;
+static const int k_tree_size_check_every = 16;
+
+// log2 bucket of visit count, 0 for 0, 1 for 1, 2 for 2~3, ..., 32 at most
+static int VisitBucket(int visit_count)
+{
+    int bucket = 0;
+    for (uint32_t v = visit_count; v; v >>= 1) ++bucket;
+    return bucket;
+}
+
+template<int N>
+MCTSEngine<N>::MCTSEngine(const MCTSConfig &config)
     : m_config(config),
       m_root(nullptr),
+      m_root_index(0),
+      m_node_arena(new TreeNodeArena),
       m_board(!config.disable_positional_superko()),
-      m_eval_task_queue(config.eval_task_queue_size()),
+      m_board_version(0),
       m_model_global_step(0),
       m_is_searching(false),
+      m_is_genmove_searching(false),
+      m_num_pending_deletes(0),
+      m_tree_size_exceeded(false),
+      m_gc_requested(false),
+      m_gc_waiting(0),
+      m_gc_epoch(0),
       m_simulation_counter(0),
       m_num_moves(0),
       m_gen_passes(0),
       m_monitor(this),
       m_debugger(this)
 {
+    m_board.SetSuperkoHistory(&m_superko_history);
+
+    // setup eval task queue
+    if (m_config.eval_priority().enable()) {
+        LOG_IF(WARNING, m_config.enable_lock_free_eval_queue()) << "eval_priority enabled, enable_lock_free_eval_queue ignored";
+        int max_overtake = m_config.eval_priority().max_overtake() ? m_config.eval_priority().max_overtake() : 64;
+        m_eval_task_queue.reset(new PriorityTaskQueue<EvalTask>(m_config.eval_task_queue_size(), max_overtake));
+    } else if (m_config.enable_lock_free_eval_queue()) {
+        int capacity = m_config.eval_task_queue_size() ? m_config.eval_task_queue_size() : 4096;
+        m_eval_task_queue.reset(new LockFreeTaskQueue<EvalTask>(capacity));
+    } else {
+        m_eval_task_queue.reset(new TaskQueue<EvalTask>(m_config.eval_task_queue_size()));
+    }
+
     // setup eval threads
     if (m_config.model_config().enable_mkl()) {
         ZeroModel::SetMKLEnv(m_config.model_config());
@@ -72,13 +111,35 @@ MCTSEngine::MCTSEngine(const MCTSConfig &config)
         m_eval_threads.emplace_back(&MCTSEngine::EvalRoutine, this, std::move(model));
     }
 
+    // setup transposition table
+    if (m_config.transposition_table().enable()) {
+        auto &c = m_config.transposition_table();
+        int64_t max_memory_mb = c.max_memory_mb() ? c.max_memory_mb() : 256;
+        m_ttable.reset(new TranspositionTable(max_memory_mb << 20, c.num_shards() ? c.num_shards() : 64));
+    }
+
+    // setup eval cache
+    if (m_config.eval_cache().enable()) {
+        auto &c = m_config.eval_cache();
+        m_eval_cache.reset(new EvalCache(c.size() ? c.size() : 100000, c.num_stripes() ? c.num_stripes() : 64,
+                                         Board::GOBOARD_SIZE + 1));
+    }
+
+    // setup pending eval table
+    if (m_config.enable_eval_coalescing()) {
+        m_pending_evals.reset(new PendingEvalTable<EvalCallback>(64));
+    }
+
     // setup search threads
     for (int i = 0; i < m_config.num_search_threads(); ++i) {
         m_search_threads.emplace_back(&MCTSEngine::SearchRoutine, this);
     }
 
-    // setup delete thread & tree root
-    m_delete_thread = std::thread(&MCTSEngine::DeleteRoutine, this);
+    // setup delete threads & tree root
+    int num_delete_threads = m_config.tree_delete().num_threads() ? m_config.tree_delete().num_threads() : 2;
+    for (int i = 0; i < num_delete_threads; ++i) {
+        m_delete_threads.emplace_back(&MCTSEngine::DeleteRoutine, this);
+    }
     ChangeRoot(nullptr);
 
     // wait
@@ -91,7 +152,8 @@ MCTSEngine::MCTSEngine(const MCTSConfig &config)
     }
 }
 
-MCTSEngine::~MCTSEngine()
+template<int N>
+MCTSEngine<N>::~MCTSEngine()
 {
     LOG(INFO) << "~MCTSEngine: Deconstructing MCTSEngine";
     m_search_threads_conductor.Terminate();
@@ -100,22 +162,28 @@ MCTSEngine::~MCTSEngine()
         th.join();
     }
     LOG(INFO) << "~MCTSEngine: Waiting eval threads terminate";
-    m_eval_task_queue.Close();
+    m_eval_task_queue->Close();
     for (auto &th: m_eval_threads) {
         th.join();
     }
-    LOG(INFO) << "~MCTSEngine: Waiting delete thread terminate";
-    m_delete_queue.Push(m_root);
+    LOG(INFO) << "~MCTSEngine: Waiting delete threads terminate";
+    m_delete_queue.Push(DeleteTask{0, 0, false, std::move(m_node_arena)});
     m_delete_queue.Close();
-    m_delete_thread.join();
+    for (auto &th: m_delete_threads) {
+        th.join();
+    }
     LOG(INFO) << "~MCTSEngine: Deconstruct MCTSEngin succ";
 }
 
-void MCTSEngine::Reset(const std::string &init_moves)
+template<int N>
+void MCTSEngine<N>::Reset(const std::string &init_moves)
 {
     SearchPause();
     ChangeRoot(nullptr);
+    m_superko_history.Clear();
     m_board.CopyFrom(GoState(!m_config.disable_positional_superko()));
+    m_board.SetSuperkoHistory(&m_superko_history);
+    ++m_board_version;
     m_simulation_counter = 0;
     m_num_moves = (init_moves.size() + 1) / 3;
     m_moves_str = init_moves;
@@ -124,9 +192,9 @@ void MCTSEngine::Reset(const std::string &init_moves)
 
     for (size_t i = 0; i < init_moves.size(); i += 3) {
         GoCoordId x, y;
-        GoFunction::StrToCoord(init_moves.substr(i, 2), x, y);
+        Board::StrToCoord(init_moves.substr(i, 2), x, y);
         m_board.Move(x, y);
-        m_root->move = GoFunction::CoordToId(x, y);
+        m_root->move = Board::CoordToId(x, y);
     }
 
     if (m_config.enable_background_search()) {
@@ -134,7 +202,8 @@ void MCTSEngine::Reset(const std::string &init_moves)
     }
 }
 
-void MCTSEngine::Move(GoCoordId x, GoCoordId y)
+template<int N>
+void MCTSEngine<N>::Move(GoCoordId x, GoCoordId y)
 {
     if (!m_byo_yomi_timer.IsEnable()) {
         auto &c = m_config.time_control();
@@ -151,19 +220,20 @@ void MCTSEngine::Move(GoCoordId x, GoCoordId y)
     }
 
     int ret = m_board.Move(x, y);
-    CHECK_EQ(ret, 0) << "Move: failed, " << GoFunction::CoordToStr(x, y) << ", ret" << ret;
+    CHECK_EQ(ret, 0) << "Move: failed, " << Board::CoordToStr(x, y) << ", ret" << ret;
+    ++m_board_version;
 
     ++m_num_moves;
     if (m_moves_str.size()) m_moves_str += ",";
-    m_moves_str += GoFunction::CoordToStr(x, y);
+    m_moves_str += Board::CoordToStr(x, y);
     LOG(INFO) << "Move: " << m_moves_str;
 
-    ChangeRoot(FindChild(m_root, GoFunction::CoordToId(x, y)));
-    m_root->move = GoFunction::CoordToId(x, y);
+    ChangeRoot(FindChild(m_root, Board::CoordToId(x, y)));
+    m_root->move = Board::CoordToId(x, y);
 
     m_debugger.UpdateLastMoveDebugStr();
     LOG(INFO) << m_debugger.GetLastMoveDebugStr();
-    m_debugger.PrintTree(1, 10, GoFunction::CoordToStr(x, y) + ",");
+    m_debugger.PrintTree(1, 10, Board::CoordToStr(x, y) + ",");
 
     m_byo_yomi_timer.HandOff();
 
@@ -171,6 +241,9 @@ void MCTSEngine::Move(GoCoordId x, GoCoordId y)
         m_config = *m_pending_config;
         m_pending_config = nullptr;
         LOG(INFO) << "reload config succ: \n" << m_config.DebugString();
+        if (m_eval_cache) {
+            m_eval_cache->Clear(); // policy post processing may change
+        }
     }
 
     if (!m_config.disable_double_pass_scoring() && m_board.IsDoublePass()) {
@@ -185,14 +258,16 @@ void MCTSEngine::Move(GoCoordId x, GoCoordId y)
     }
 }
 
-void MCTSEngine::GenMove(GoCoordId &x, GoCoordId &y)
+template<int N>
+void MCTSEngine<N>::GenMove(GoCoordId &x, GoCoordId &y)
 {
     std::vector<int> visit_count;
     float v_resign;
     GenMove(x, y, visit_count, v_resign);
 }
 
-void MCTSEngine::GenMove(GoCoordId &x, GoCoordId &y, std::vector<int> &visit_count, float &v_resign)
+template<int N>
+void MCTSEngine<N>::GenMove(GoCoordId &x, GoCoordId &y, std::vector<int> &visit_count, float &v_resign)
 {
     if (!m_byo_yomi_timer.IsEnable()) {
         auto &c = m_config.time_control();
@@ -219,14 +294,15 @@ void MCTSEngine::GenMove(GoCoordId &x, GoCoordId &y, std::vector<int> &visit_cou
         move = GetSamplingMove(m_config.genmove_temperature());
         v_resign = 1.0f;
     }
-    GoFunction::IdToCoord(move, x, y);
+    Board::IdToCoord(move, x, y);
 
     if (move == GoComm::COORD_PASS) {
         ++m_gen_passes;
     }
 }
 
-bool MCTSEngine::Undo()
+template<int N>
+bool MCTSEngine<N>::Undo()
 {
     if (m_num_moves == 0) {
         return false;
@@ -235,137 +311,344 @@ bool MCTSEngine::Undo()
     return true;
 }
 
-const GoState &MCTSEngine::GetBoard()
+template<int N>
+const GoStateT<N> &MCTSEngine<N>::GetBoard()
 {
     return m_board;
 }
 
-MCTSConfig &MCTSEngine::GetConfig()
+template<int N>
+MCTSConfig &MCTSEngine<N>::GetConfig()
 {
     return m_config;
 }
 
-void MCTSEngine::SetPendingConfig(std::unique_ptr<MCTSConfig> config)
+template<int N>
+void MCTSEngine<N>::SetPendingConfig(std::unique_ptr<MCTSConfig> config)
 {
     m_pending_config = std::move(config);
 }
 
-MCTSDebugger &MCTSEngine::GetDebugger()
+template<int N>
+MCTSDebugger<N> &MCTSEngine<N>::GetDebugger()
 {
     return m_debugger;
 }
 
-int MCTSEngine::GetModelGlobalStep()
+template<int N>
+int MCTSEngine<N>::GetModelGlobalStep()
 {
     return m_model_global_step;
 }
 
-ByoYomiTimer &MCTSEngine::GetByoYomiTimer()
+template<int N>
+ByoYomiTimer &MCTSEngine<N>::GetByoYomiTimer()
 {
     return m_byo_yomi_timer;
 }
 
-TreeNode *MCTSEngine::InitNode(TreeNode *node, TreeNode *fa, int move, float prior_prob)
+template<int N>
+TreeNode *MCTSEngine<N>::InitNode(TreeNode *node, uint32_t fa, int move, float prior_prob)
 {
+    node->count = 0;
+    node->total_action = 0;
     node->fa = fa;
-    node->ch = nullptr;
-    node->ch_len = 0;
-    node->size = 1;
-    node->expand_state = k_unexpanded;
+    node->ch = 0;
+    node->SetExpandState(k_unexpanded);
     node->move = move;
-    node->visit_count = 0;
-    node->virtual_loss_count = 0;
-    node->total_action = 0;
-    node->prior_prob = prior_prob;
-    node->value = NAN;
+    node->SetPriorProb(prior_prob);
+    node->SetValue(NAN);
     return node;
 }
 
-TreeNode *MCTSEngine::FindChild(TreeNode *node, int move)
+template<int N>
+TreeNode *MCTSEngine<N>::FindChild(TreeNode *node, int move)
 {
-    TreeNode *ch = node->ch;
-    int ch_len = node->ch_len;
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(node, ch);
     for (int i = 0; i < ch_len; ++i) {
-        if (ch[i].move == move) {
-            return &ch[i];
+        if (ch[i]->move == move) {
+            return ch[i];
         }
     }
     return nullptr;
 }
 
-void MCTSEngine::Eval(const GoState &board, EvalCallback callback)
+template<int N>
+int MCTSEngine<N>::GetChildren(TreeNode *node, TreeNode **ch)
+{
+    int ch_len = node->ChLen();
+    if (node->IsLazy()) {
+        TreeEdge *edges = m_node_arena->GetEdges(node->ch);
+        for (int i = 0; i < ch_len; ++i) {
+            uint32_t child = edges[i].child;
+            if (child == 0) {
+                return i;
+            }
+            ch[i] = m_node_arena->Get(child);
+        }
+    } else {
+        TreeNode *block = m_node_arena->Get(node->ch);
+        int stride = node->ChStride();
+        for (int i = 0; i < ch_len; ++i) {
+            ch[i] = &block[i * stride];
+        }
+    }
+    return ch_len;
+}
+
+template<int N>
+TreeNode *MCTSEngine<N>::CreateChild(uint32_t node_index, TreeEdge *edge, uint32_t &child_index)
+{
+    uint32_t child = m_node_arena->Allocate(1);
+    InitNode(m_node_arena->Get(child), node_index, edge->move, edge->PriorProb());
+    uint32_t expect = 0;
+    if (!edge->child.compare_exchange_strong(expect, child)) {
+        m_node_arena->Free(child, 1); // created by other thread
+        child = expect;
+    }
+    child_index = child;
+    return m_node_arena->Get(child);
+}
+
+template<int N>
+uint32_t MCTSEngine<N>::GetNodeIndex(TreeNode *node)
+{
+    if (node == m_root) {
+        return m_root_index;
+    }
+    TreeNode *fa = m_node_arena->Get(node->fa);
+    if (fa->IsLazy()) {
+        TreeEdge *edges = m_node_arena->GetEdges(fa->ch);
+        int ch_len = fa->ChLen();
+        for (int i = 0; i < ch_len; ++i) {
+            uint32_t child = edges[i].child;
+            if (m_node_arena->Get(child) == node) {
+                return child;
+            }
+        }
+        LOG(FATAL) << "GetNodeIndex: node not found in children of its father";
+    }
+    return fa->ch + (node - m_node_arena->Get(fa->ch));
+}
+
+template<int N>
+void MCTSEngine<N>::SetChildrenFa(TreeNode *node, uint32_t fa)
+{
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(node, ch);
+    for (int i = 0; i < ch_len; ++i) {
+        ch[i]->fa = fa;
+    }
+}
+
+template<int N>
+void MCTSEngine<N>::MoveNode(TreeNode *src, TreeNode *dst, uint32_t dst_index)
+{
+    dst->count = src->count.load();
+    dst->total_action = src->total_action.load();
+    dst->move = src->move;
+    dst->prior_prob = src->prior_prob.load();
+    dst->value = src->value.load();
+    dst->ch = src->ch.load();
+    dst->state = src->state.load();
+    SetChildrenFa(dst, dst_index);
+    src->ch = 0;
+    src->SetExpandState(src->ExpandState()); // clear ch_len
+}
+
+template<int N>
+void MCTSEngine<N>::RebuildChildren(TreeNode *node, bool padded)
+{
+    uint32_t node_index = GetNodeIndex(node);
+    int ch_len = node->ChLen();
+    int stride = padded ? 2 : 1;
+    uint32_t ch_index = padded ? m_node_arena->AllocatePadded(ch_len) : m_node_arena->Allocate(ch_len);
+    TreeNode *ch = m_node_arena->Get(ch_index);
+    if (node->IsLazy()) {
+        TreeEdge *edges = m_node_arena->GetEdges(node->ch);
+        for (int i = 0; i < ch_len; ++i) {
+            uint32_t child = edges[i].child;
+            if (child) {
+                MoveNode(m_node_arena->Get(child), &ch[i * stride], ch_index + i * stride);
+                ch[i * stride].fa = node_index;
+                m_node_arena->Free(child, 1);
+            } else {
+                InitNode(&ch[i * stride], node_index, edges[i].move, edges[i].PriorProb());
+            }
+        }
+        m_node_arena->Free(node->ch, TreeNodeArena::EdgeBlockSize(ch_len));
+    } else {
+        TreeNode *old_ch = m_node_arena->Get(node->ch);
+        int old_stride = node->ChStride();
+        for (int i = 0; i < ch_len; ++i) {
+            MoveNode(&old_ch[i * old_stride], &ch[i * stride], ch_index + i * stride);
+            ch[i * stride].fa = node_index;
+        }
+        if (node->IsPadded()) {
+            m_node_arena->FreePadded(node->ch, ch_len);
+        } else {
+            m_node_arena->Free(node->ch, ch_len);
+        }
+    }
+    node->ch = ch_index;
+    node->SetExpandState(k_expanded, ch_len, padded ? TreeNode::k_padded_flag : 0);
+}
+
+template<int N>
+int MCTSEngine<N>::GetNodeDepth(TreeNode *node, int max_depth)
+{
+    int depth = 0;
+    while (node != m_root && depth < max_depth) {
+        node = m_node_arena->Get(node->fa);
+        ++depth;
+    }
+    return depth;
+}
+
+template<int N>
+void MCTSEngine<N>::Eval(const GoState &board, EvalCallback callback, float priority)
 {
     if (!m_config.disable_double_pass_scoring() && board.IsDoublePass()) {
         std::vector<float> policy;
-        policy.assign(GoComm::GOBOARD_SIZE + 1, 0.0f);
+        policy.assign(Board::GOBOARD_SIZE + 1, 0.0f);
         policy.back() = 1.0f; // pass
         float value = (board.GetWinner() == board.CurrentPlayer()) ? -1.0f : 1.0f;
         callback(0, std::move(policy), value);
         return;
     }
 
+    uint64_t cache_key = 0;
+    std::bitset<Board::GOBOARD_SIZE> legal_moves;
+    if (m_eval_cache) {
+        cache_key = board.GetHistoryHashValue();
+        std::vector<float> policy;
+        float value;
+        if (EvalCacheFind(cache_key, policy, value)) {
+            callback(0, std::move(policy), value);
+            return;
+        }
+        for (int i = 0; i < Board::GOBOARD_SIZE; ++i) {
+            legal_moves[i] = board.IsLegal(i);
+        }
+    }
+
+    if (m_pending_evals) {
+        if (!m_eval_cache) {
+            cache_key = board.GetHistoryHashValue();
+        }
+        if (AttachPendingEval(cache_key, callback)) {
+            return;
+        }
+    }
+
     Timer timer;
-    auto features = board.GetFeature();
+    FeatureSlotPool::Slot *slot = m_feature_slots.Reserve();
+    board.GetFeaturePlanes(slot->features.planes);
     int transform_mode = g_random_engine() & 7;
-    TransformFeatures(features, transform_mode);
+    TransformFeatures(slot->features, transform_mode);
 
     bool dumb_pass = board.GetWinner() != board.CurrentPlayer();
 
     callback =
-        [this, callback, timer, transform_mode, dumb_pass]
+        [this, callback, timer, transform_mode, dumb_pass, cache_key, legal_moves]
         (int ret, std::vector<float> policy, float value) {
             if (ret == 0) {
                 if (dumb_pass && value < 0.5 && !m_config.disable_double_pass_scoring()) {
                     policy.back() = std::min(policy.back(), 1e-5f); // disallow dumb PASS
                 }
 
-                CHECK_EQ(policy.size(), GoComm::GOBOARD_SIZE + 1)
-                    << "Eval: invalid policy.size(), expect " << GoComm::GOBOARD_SIZE + 1 << ", got " << policy.size();
+                CHECK_EQ(policy.size(), Board::GOBOARD_SIZE + 1)
+                    << "Eval: invalid policy.size(), expect " << Board::GOBOARD_SIZE + 1 << ", got " << policy.size();
                 if (m_config.enable_policy_temperature()) {
                     ApplyTemperature(policy, m_config.policy_temperature());
                 }
                 float pass_policy = policy.back();
-                policy.pop_back(); // make it 19x19
+                policy.pop_back(); // make it NxN
                 TransformFeatures(policy, transform_mode, true);
                 policy.push_back(pass_policy);
+
+                if (m_eval_cache) {
+                    for (int i = 0; i < Board::GOBOARD_SIZE; ++i) {
+                        if (!legal_moves[i]) policy[i] = 0.0f;
+                    }
+                    EvalCacheInsert(cache_key, policy, value);
+                }
+            }
+            if (m_pending_evals) {
+                for (auto &waiter: m_pending_evals->Complete(cache_key)) {
+                    waiter(ret, policy, value);
+                }
             }
             m_monitor.MonEvalCostMs(timer.fms());
             callback(ret, std::move(policy), value);
         };
 
+    m_eval_arrivals.Add(1);
+    std::promise<std::tuple<int, std::vector<float>, float>> promise; // sync mode waits for it
+    EvalTask task{slot, nullptr, priority};
     if (m_config.enable_async()) {
         m_eval_tasks_wg.Add();
-        m_eval_task_queue.Push(
-            EvalTask {
-                features,
-                [this, callback](int ret, std::vector<float> policy, float value) {
-                    callback(ret, std::move(policy), value);
-                    m_eval_tasks_wg.Done();
-                }
-            }
-        );
+        task.callback = [this, callback](int ret, std::vector<float> policy, float value) {
+            callback(ret, std::move(policy), value);
+            m_eval_tasks_wg.Done();
+        };
     } else {
-        std::promise<std::tuple<int, std::vector<float>, float>> promise;
-        m_eval_task_queue.Push(
-            EvalTask {
-                features,
-                [&promise](int ret, std::vector<float> policy, float value) {
-                    promise.set_value(std::make_tuple(ret, std::move(policy), value));
-                }
-            }
-        );
+        task.callback = [&promise](int ret, std::vector<float> policy, float value) {
+            promise.set_value(std::make_tuple(ret, std::move(policy), value));
+        };
+    }
+    if (!m_eval_task_queue->Push(std::move(task))) {
+        LOG(WARNING) << "Eval: eval task queue closed";
+        m_feature_slots.Release(slot);
+        task.callback(ERR_TASK_QUEUE_CLOSED, {}, 0.0f);
+    }
+    if (!m_config.enable_async()) {
         int ret;
         std::vector<float> policy;
         float value;
         std::tie(ret, policy, value) = promise.get_future().get();
         callback(ret, std::move(policy), value);
     }
-    m_monitor.MonTaskQueueSize(m_eval_task_queue.Size());
+    m_monitor.MonTaskQueueSize(m_eval_task_queue->Size());
+}
+
+template<int N>
+bool MCTSEngine<N>::AttachPendingEval(uint64_t key, EvalCallback &callback)
+{
+    std::unique_ptr<std::promise<std::tuple<int, std::vector<float>, float>>> promise;
+    bool attached = m_pending_evals->Attach(key, [this, &callback, &promise]() -> EvalCallback {
+        if (m_config.enable_async()) {
+            return std::move(callback);
+        }
+        promise.reset(new std::promise<std::tuple<int, std::vector<float>, float>>);
+        auto *p = promise.get();
+        return [p](int ret, std::vector<float> policy, float value) {
+            p->set_value(std::make_tuple(ret, std::move(policy), value));
+        };
+    });
+    if (!attached) {
+        return false;
+    }
+    m_monitor.IncEvalCoalesced();
+    if (promise) { // sync mode, wait here as for our own eval
+        int ret;
+        std::vector<float> policy;
+        float value;
+        std::tie(ret, policy, value) = promise->get_future().get();
+        callback(ret, std::move(policy), value);
+    }
+    return true;
 }
 
-void MCTSEngine::EvalRoutine(std::unique_ptr<ZeroModelBase> model)
+template<int N>
+void MCTSEngine<N>::EvalRoutine(std::unique_ptr<ZeroModelBase> model)
 {
-    int ret = model->Init(m_config.model_config());
+    ModelConfig model_config = m_config.model_config();
+    CHECK(model_config.board_size() == 0 || model_config.board_size() == N)
+        << "EvalRoutine: model_config.board_size " << model_config.board_size() << " unmatch board_size " << N;
+    model_config.set_board_size(N);
+    int ret = model->Init(model_config);
     CHECK_EQ(ret, 0) << "EvalRoutine: model init failed, ret " << ret;
 
     int global_step;
@@ -378,45 +661,80 @@ void MCTSEngine::EvalRoutine(std::unique_ptr<ZeroModelBase> model)
         CHECK_EQ(expect_zero, global_step) << "EvalRoutine: global_step different with other routines";
     }
 
+    std::shared_ptr<BatchController> batch_controller;
+    if (m_config.adaptive_batch().enable()) {
+        int max_batch_size = m_config.eval_batch_size();
+        if (!m_config.enable_async()) { // search threads wait for their evals, each eval thread gets its share of them
+            int num_eval_threads = m_config.num_eval_threads();
+            max_batch_size = std::min(max_batch_size, (m_config.num_search_threads() + num_eval_threads - 1) / num_eval_threads);
+        }
+        batch_controller = std::make_shared<BatchController>(max_batch_size, m_config.num_eval_threads(),
+                                                             m_config.eval_wait_batch_timeout_us(),
+                                                             m_config.adaptive_batch().max_latency_ms());
+    }
+
+    // eval_wait_batch_timeout_us is the wait for each next task, as always, or the wait for the whole batch
+    // if opted in to the lock free queue or adaptive batch
+    bool batch_deadline = batch_controller ||
+        (m_config.enable_lock_free_eval_queue() && !m_config.eval_priority().enable());
+
+    // features of a batch by slot, models unpack them straight from the slots search threads wrote
+    std::vector<const PackedFeatures *> inputs;
+    inputs.reserve(m_config.eval_batch_size());
+
     m_eval_threads_init_wg.Done();
     for (;;) {
         model->Wait();
 
-        EvalTask task;
-        std::vector<std::vector<bool>> inputs;
-        std::vector<EvalCallback> callbacks;
-        for (int i = 0; i < m_config.eval_batch_size(); ++i) {
-            if (m_eval_task_queue.Pop(task, i ? m_config.eval_wait_batch_timeout_us() : -1)) {
-                inputs.push_back(std::move(task.features));
-                callbacks.push_back(std::move(task.callback));
-            } else if (m_eval_task_queue.IsClose()) {
-                LOG(WARNING) << "EvalRoutine: terminate";
-                return; // terminate
-            } else { // timeout
-                break;
-            }
+        int max_batch_size = m_config.eval_batch_size();
+        int64_t wait_us = m_config.eval_wait_batch_timeout_us();
+        if (batch_controller) {
+            batch_controller->Plan(m_eval_arrivals.Sum(), m_eval_task_queue->Size(), max_batch_size, wait_us);
         }
 
-        size_t batch_size = inputs.size();
+        // wait for the first task, then wait_us at most for the rest of batch, or for each of the rest
+        auto tasks = std::make_shared<std::vector<EvalTask>>();
+        if (batch_deadline) {
+            m_eval_task_queue->PopBatch(*tasks, max_batch_size, wait_us);
+        } else {
+            EvalTask task;
+            for (int i = 0; i < max_batch_size && m_eval_task_queue->Pop(task, i ? wait_us : -1); ++i) {
+                tasks->push_back(std::move(task));
+            }
+        }
+        if (tasks->empty()) {
+            LOG(WARNING) << "EvalRoutine: terminate";
+            return; // terminate
+        }
+        size_t batch_size = tasks->size();
+        inputs.resize(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            inputs[i] = &(*tasks)[i].slot->features;
+        }
         m_monitor.MonEvalBatchSize(batch_size);
 
+        // tasks keep their slots until the result is back, timeout ones are retried with them
         Timer timer;
         model->Forward(
             inputs,
-            [this, inputs, callbacks, batch_size, timer]
+            [this, tasks, batch_size, timer, batch_controller]
             (int ret, std::vector<std::vector<float>> policy, std::vector<float> value) {
                 m_monitor.MonEvalCostMsPerBatch(timer.fms());
+                if (batch_controller && ret == 0) {
+                    batch_controller->OnForward(batch_size, timer.fms());
+                }
 
                 // fill result
                 if (ret == ERR_FORWARD_TIMEOUT) {
                     m_monitor.IncEvalTimeout();
-                    for (size_t i = 0; i < batch_size; ++i) {
-                        m_eval_task_queue.PushFront(EvalTask{std::move(inputs[i]), std::move(callbacks[i])});
+                    for (auto &task: *tasks) {
+                        m_eval_task_queue->PushFront(std::move(task));
                     }
                 } else if (ret) {
                     LOG(ERROR) << "EvalRoutine: feed model failed, ret " << ret;
-                    for (size_t i = 0; i < batch_size; ++i) {
-                        callbacks[i](ret, {}, 0.0);
+                    for (auto &task: *tasks) {
+                        m_feature_slots.Release(task.slot);
+                        task.callback(ret, {}, 0.0);
                     }
                 } else {
                     CHECK_EQ(batch_size, policy.size())
@@ -424,7 +742,8 @@ void MCTSEngine::EvalRoutine(std::unique_ptr<ZeroModelBase> model)
                     CHECK_EQ(batch_size, value.size())
                         << "EvalRoutine: batch size unmatch, expect " << batch_size << ", got" << policy.size();
                     for (size_t i = 0; i < batch_size; ++i) {
-                        callbacks[i](ret, std::move(policy[i]), value[i]);
+                        m_feature_slots.Release((*tasks)[i].slot);
+                        (*tasks)[i].callback(ret, std::move(policy[i]), value[i]);
                     }
                 }
             }
@@ -436,97 +755,113 @@ void MCTSEngine::EvalRoutine(std::unique_ptr<ZeroModelBase> model)
     }
 }
 
-TreeNode *MCTSEngine::Select(GoState &board)
+template<int N>
+TreeNode *MCTSEngine<N>::Select(GoState &board, GoJournal &journal, std::vector<uint64_t> &path_hashes, float &priority,
+                                uint32_t &node_index)
 {
     TreeNode *node = m_root;
+    node_index = m_root_index;
+    TreeNode *fa = nullptr;
     int depth = 1;
-    ++node->virtual_loss_count;
-    while (node->expand_state == k_expanded) {
-        node = SelectChild(node);
-        ++node->virtual_loss_count;
-        int ret = board.Move(node->move);
+    node->AddVirtualLoss();
+    if (m_ttable) path_hashes.push_back(board.GetHashValue());
+    while (node->ExpandState() == k_expanded) {
+        fa = node;
+        node = SelectChild(node, node_index);
+        node->AddVirtualLoss();
+        int ret = board.Move(node->move, journal);
 
         CHECK_EQ(ret, 0) << "Move: failed, move=" << m_root->move << ", ret" << ret;
+        if (m_ttable) path_hashes.push_back(board.GetHashValue());
         ++depth;
     }
+    // how much the result of this leaf weighs in root's value, the root itself and its children come first
+    priority = fa ? std::min((float)fa->VisitCount() / std::max(m_root->VisitCount(), 1), 1.0f) : 1.0f;
     m_monitor.MonSearchTreeHeight(depth);
     return node;
 }
 
-TreeNode *MCTSEngine::SelectChild(TreeNode *node)
+template<int N>
+TreeNode *MCTSEngine<N>::SelectChild(TreeNode *node, uint32_t &node_index)
 {
-    TreeNode *ch = node->ch;
-    int ch_len = node->ch_len;
-    CHECK_GT(ch_len, 0);
-    int visit_count[GoComm::GOBOARD_SIZE + 1];
-    float virtual_loss[GoComm::GOBOARD_SIZE + 1];
-    float total_action[GoComm::GOBOARD_SIZE + 1];
-    for (int i = 0; i < ch_len; ++i) {
-        visit_count[i] = ch[i].visit_count;
-        virtual_loss[i] = ch[i].virtual_loss_count * m_config.virtual_loss();
-        total_action[i] = (float)ch[i].total_action / k_action_value_base;
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(node, ch);
+    // for lazily expanded node, the first edge without child has the largest prior of all unvisited children
+    TreeEdge *new_edge = nullptr;
+    if (node->IsLazy() && ch_len < node->ChLen()) {
+        auto &c = m_config.lazy_expand();
+        int max_width = c.widening_factor() > 0 ?
+            (int)(c.widening_base() + c.widening_factor() * std::sqrt((float)node->VisitCount())) : ch_len + 1;
+        if (ch_len < std::max(max_width, 1)) {
+            new_edge = &m_node_arena->GetEdges(node->ch)[ch_len];
+        }
     }
-    float sigma_visit_count = std::accumulate(visit_count, visit_count + ch_len, 0);
+    CHECK(ch_len > 0 || new_edge != nullptr);
+    PuctStats stats;
+    int sigma_visit_count = 0;
+    float sigma_virtual_loss = 0.0f;
+    for (int i = 0; i < ch_len; ++i) {
+        uint64_t count = ch[i]->count;
+        int visit_count = TreeNode::VisitCount(count);
+        float virtual_loss = TreeNode::VirtualLossCount(count) * m_config.virtual_loss();
+        stats.visit_count[i] = visit_count;
+        stats.virtual_loss[i] = virtual_loss;
+        stats.total_action[i] = (float)ch[i]->total_action / k_action_value_base;
+        stats.prior_prob[i] = ch[i]->PriorProb();
+        sigma_visit_count += visit_count;
+        sigma_virtual_loss += virtual_loss;
+    }
+    stats.size = ch_len;
+    stats.PadTail();
+    float sigma = sigma_visit_count;
     if ((m_config.virtual_loss_mode() & 1) == 0) {
-        sigma_visit_count += std::accumulate(virtual_loss, virtual_loss + ch_len, 0.0f);
+        sigma += sigma_virtual_loss;
     }
-    float sqrt_sigma_visit_count = std::sqrt(sigma_visit_count);
-    sqrt_sigma_visit_count = std::max(sqrt_sigma_visit_count, 1.0f);
-    float best;
-    TreeNode *best_ch = nullptr;
+    float sqrt_sigma_visit_count = std::max(std::sqrt(sigma), 1.0f);
     float default_act = m_config.default_act();
-    if (m_config.inherit_default_act() && node->visit_count) {
-        default_act = -(float)node->total_action / k_action_value_base / node->visit_count;
+    int node_visit_count = node->VisitCount();
+    if (m_config.inherit_default_act() && node_visit_count) {
+        default_act = -(float)node->total_action / k_action_value_base / node_visit_count;
         if (m_config.inherit_default_act_factor() > 0) {
             default_act *= m_config.inherit_default_act_factor();
         }
     }
-    for (int i = 0; i < ch_len; ++i) {
-        float act;
-        if (visit_count[i] == 0 && virtual_loss[i] == 0) {
-            act = default_act;
-        } else if ((m_config.virtual_loss_mode() & 2) == 0) {
-            act = (total_action[i] - virtual_loss[i]) / (visit_count[i] + virtual_loss[i]);
-        } else {
-            act = total_action[i] / visit_count[i];
-        }
-
-        float ucb;
-        if ((m_config.virtual_loss_mode() & 1) == 0) {
-            ucb = m_config.c_puct() * ch[i].prior_prob *
-                  sqrt_sigma_visit_count / (1 + visit_count[i] + virtual_loss[i]);
-        } else {
-            ucb = m_config.c_puct() * ch[i].prior_prob *
-                  sqrt_sigma_visit_count / (1 + visit_count[i]);
-        }
-
-        float score = act + ucb;
-        if (best_ch == nullptr || score > best) {
-            best = score;
-            best_ch = &ch[i];
+    float best;
+    int best_i = PuctSelect(stats, m_config.virtual_loss_mode(), m_config.c_puct(), sqrt_sigma_visit_count,
+                            default_act, best);
+    if (new_edge) {
+        float score = default_act + m_config.c_puct() * new_edge->PriorProb() * sqrt_sigma_visit_count;
+        if (best_i < 0 || score > best) {
+            return CreateChild(node_index, new_edge, node_index);
         }
     }
-    return best_ch;
+    best_i = std::max(best_i, 0); // all scores are NaN
+    node_index = node->IsLazy() ? m_node_arena->GetEdges(node->ch)[best_i].child.load()
+                                : node->ch + best_i * node->ChStride();
+    return ch[best_i];
 }
 
-int MCTSEngine::Expand(TreeNode *node, GoState &board, const std::vector<float> &policy)
+template<int N>
+int MCTSEngine<N>::Expand(TreeNode *node, uint32_t node_index, const LeafSnapshot<N> &leaf,
+                          const std::vector<float> &policy)
 {
-    if (!m_config.disable_double_pass_scoring() && board.IsDoublePass()) {
-        node->expand_state = k_unexpanded;
+    if (!m_config.disable_double_pass_scoring() && leaf.is_double_pass) {
+        node->SetExpandState(k_unexpanded);
         return 0;
     }
 
     Timer timer;
     int ch_len = 0;
     float policy_sum = 0;
-    int moves[GoComm::GOBOARD_SIZE + 1];
-    for (int i = 0; i < GoComm::GOBOARD_SIZE; ++i) {
-        if (board.IsLegal(i)) {
+    int moves[Board::GOBOARD_SIZE + 1];
+    for (int w = 0; w < Board::BOARD_STATE_SIZE; ++w) {
+        for (uint64_t bits = leaf.legal_moves[w]; bits; bits ^= Lowbit(bits)) {
+            int i = (w << 6) + __builtin_ctzll(bits);
             moves[ch_len++] = i;
             policy_sum += policy[i];
         }
     }
-    moves[ch_len++] = GoComm::GOBOARD_SIZE; // PASS
+    moves[ch_len++] = Board::GOBOARD_SIZE; // PASS
     policy_sum += policy.back(); // PASS
 
     int max_ch_len = m_config.max_children_per_node();
@@ -536,61 +871,101 @@ int MCTSEngine::Expand(TreeNode *node, GoState &board, const std::vector<float>
         ch_len = max_ch_len;
     }
 
-    TreeNode *ch = new TreeNode[ch_len];
+    // children near the root are touched by every simulation, give each of them a cache line
+    int padded_depth = m_config.node_layout().padded_depth();
+    bool padded = padded_depth > 0 && GetNodeDepth(node, padded_depth) < padded_depth;
+
+    // root always has all children created, for dirichlet noise and move selection
+    if (m_config.lazy_expand().enable() && !padded && node != m_root) {
+        std::sort(moves, moves + ch_len, [&policy](int i, int j) { return policy[i] > policy[j]; });
+        uint32_t edges_index = m_node_arena->Allocate(TreeNodeArena::EdgeBlockSize(ch_len));
+        TreeEdge *edges = m_node_arena->GetEdges(edges_index);
+        for (int i = 0; i < ch_len; ++i) {
+            edges[i].move = moves[i] == Board::GOBOARD_SIZE ? GoComm::COORD_PASS : moves[i];
+            edges[i].prior_prob = FloatToHalf(policy[moves[i]] / policy_sum);
+            edges[i].child = 0;
+        }
+        node->ch = edges_index;
+        node->SetExpandState(k_expanded, ch_len, TreeNode::k_lazy_flag);
+        m_monitor.MonExpandCostMs(timer.fms());
+        return ch_len;
+    }
+
+    int stride = padded ? 2 : 1;
+    uint32_t ch_index = padded ? m_node_arena->AllocatePadded(ch_len) : m_node_arena->Allocate(ch_len);
+    TreeNode *ch = m_node_arena->Get(ch_index);
     for (int i = 0; i < ch_len; ++i) {
-        if (moves[i] == GoComm::GOBOARD_SIZE) {
-            InitNode(&ch[i], node, GoComm::COORD_PASS, policy[moves[i]] / policy_sum);
+        if (moves[i] == Board::GOBOARD_SIZE) {
+            InitNode(&ch[i * stride], node_index, GoComm::COORD_PASS, policy[moves[i]] / policy_sum);
         } else {
-            InitNode(&ch[i], node, moves[i], policy[moves[i]] / policy_sum);
+            InitNode(&ch[i * stride], node_index, moves[i], policy[moves[i]] / policy_sum);
         }
     }
 
-    node->ch = ch;
-    node->ch_len = ch_len;
-    node->expand_state = k_expanded;
+    node->ch = ch_index;
+    node->SetExpandState(k_expanded, ch_len, padded ? TreeNode::k_padded_flag : 0);
 
     m_monitor.MonExpandCostMs(timer.fms());
     return ch_len;
 }
 
-void MCTSEngine::Backup(TreeNode *node, float value_f, int ch_len)
+template<int N>
+void MCTSEngine<N>::Backup(TreeNode *node, float value_f, const std::vector<uint64_t> &path_hashes,
+                           float tt_value, int tt_weight)
 {
     Timer timer;
-    node->value = value_f;
+    node->SetValue(value_f);
     int64_t value = value_f * k_action_value_base;
+    // a transposed leaf backs up its eval blended with the mean value of its position, still as one visit,
+    // the table only gets the eval so that its means are not fed back into it
+    int64_t tree_value = value;
+    if (tt_weight > 0) {
+        int max_weight = m_config.transposition_table().max_seed_weight();
+        tt_weight = std::min(tt_weight, max_weight > 0 ? max_weight : 1);
+        tree_value = (value_f + tt_weight * tt_value) / (1 + tt_weight) * k_action_value_base;
+    }
+    // each update locks a table shard, only positions near the leaf are updated, new leaves are looked up anyway
+    int update_depth = m_config.transposition_table().update_depth();
+    update_depth = std::min(update_depth > 0 ? update_depth : 4, (int)path_hashes.size());
+    auto hash = path_hashes.rbegin();
+    auto hash_end = hash + update_depth;
     int depth = 1;
     while (node != nullptr) {
-        node->size += ch_len;
         ++depth;
-        ++node->visit_count;
-        --node->virtual_loss_count;
-        node->total_action += value;
-        node = node->fa;
+        node->AddVisit();
+        node->total_action += tree_value;
+        if (hash != hash_end) {
+            TTableUpdate(*hash++, value);
+        }
+        node = m_node_arena->Get(node->fa);
         value = -value;
+        tree_value = -tree_value;
         value_f = -value_f;
     }
     m_monitor.MonBackupCostMs(timer.fms());
 }
 
-void MCTSEngine::UndoVirtualLoss(TreeNode *node)
+template<int N>
+void MCTSEngine<N>::UndoVirtualLoss(TreeNode *node)
 {
     while (node != nullptr) {
-        --node->virtual_loss_count;
-        node = node->fa;
+        node->UndoVirtualLoss();
+        node = m_node_arena->Get(node->fa);
     }
 }
 
-bool MCTSEngine::CheckEarlyStop(int64_t timeout_us)
+template<int N>
+bool MCTSEngine<N>::CheckEarlyStop(int64_t timeout_us)
 {
     auto &c = m_config.early_stop();
     if (!c.enable() || m_simulation_counter < c.sims_threshold()) {
         return false;
     }
     int max_visit_count[] = {0, 0};
-    TreeNode *ch = m_root->ch;
-    int ch_len = m_root->ch_len;
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(m_root, ch);
     for (int i = 0; i < ch_len; ++i) {
-        int visit_count = ch[i].visit_count;
+        int visit_count = ch[i]->VisitCount();
         if (visit_count > max_visit_count[1]) {
             if (visit_count > max_visit_count[0]) {
                 max_visit_count[1] = max_visit_count[0];
@@ -615,35 +990,37 @@ bool MCTSEngine::CheckEarlyStop(int64_t timeout_us)
     return false;
 }
 
-bool MCTSEngine::CheckUnstable()
+template<int N>
+bool MCTSEngine<N>::CheckUnstable()
 {
     auto &c = m_config.unstable_overtime();
     if (!c.enable()) {
         return false;
     }
-    TreeNode *ch = m_root->ch;
-    int ch_len = m_root->ch_len;
-    int visit_count[GoComm::GOBOARD_SIZE + 1];
-    float mean_action[GoComm::GOBOARD_SIZE + 1];
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(m_root, ch);
+    int visit_count[Board::GOBOARD_SIZE + 1];
+    float mean_action[Board::GOBOARD_SIZE + 1];
     for (int i = 0; i < ch_len; ++i) {
-        visit_count[i] = ch[i].visit_count;
+        visit_count[i] = ch[i]->VisitCount();
         mean_action[i] = visit_count[i] == 0 ? 0.0f :
-                         (float)ch[i].total_action / k_action_value_base / visit_count[i];
+                         (float)ch[i]->total_action / k_action_value_base / visit_count[i];
     }
     int n_best = std::max_element(visit_count, visit_count + ch_len) - visit_count;
     int q_best = std::max_element(mean_action, mean_action + ch_len) - mean_action;
     if (n_best != q_best) {
         LOG(INFO) << "CheckUnstable: return true"
-                  << ", N best ch=" << GoFunction::IdToStr(ch[n_best].move)
+                  << ", N best ch=" << Board::IdToStr(ch[n_best]->move)
                   << ", N=" << visit_count[n_best] << ", Q=" << mean_action[n_best]
-                  << ", Q best ch=" << GoFunction::IdToStr(ch[q_best].move)
+                  << ", Q best ch=" << Board::IdToStr(ch[q_best]->move)
                   << ", N=" << visit_count[q_best] << ", Q=" << mean_action[q_best];
         return true;
     }
     return false;
 }
 
-bool MCTSEngine::CheckBehind()
+template<int N>
+bool MCTSEngine<N>::CheckBehind()
 {
     auto &c = m_config.behind_overtime();
     if (!c.enable()) {
@@ -656,18 +1033,19 @@ bool MCTSEngine::CheckBehind()
         return true;
     }
     TreeNode *best_ch = FindChild(m_root, best_move);
-    int visit_count = best_ch->visit_count;
+    int visit_count = best_ch->VisitCount();
     float mean_action = visit_count == 0 ? 0.0f :
                         (float)best_ch->total_action / k_action_value_base / visit_count;
     if (mean_action < c.act_threshold()) {
-        LOG(INFO) << "CheckBehind: return true, best_move=" << GoFunction::IdToStr(best_move)
+        LOG(INFO) << "CheckBehind: return true, best_move=" << Board::IdToStr(best_move)
                   << ", N=" << visit_count << ", Q=" << mean_action;
         return true;
     }
     return false;
 }
 
-int64_t MCTSEngine::GetSearchTimeoutUs()
+template<int N>
+int64_t MCTSEngine<N>::GetSearchTimeoutUs()
 {
     int64_t timeout_us = -1;
     auto &c = m_config.time_control();
@@ -706,7 +1084,8 @@ int64_t MCTSEngine::GetSearchTimeoutUs()
     return timeout_us;
 }
 
-int64_t MCTSEngine::GetSearchOvertimeUs(int64_t timeout_us)
+template<int N>
+int64_t MCTSEngine<N>::GetSearchOvertimeUs(int64_t timeout_us)
 {
     if (timeout_us > 0) {
         if (CheckUnstable()) {
@@ -719,8 +1098,10 @@ int64_t MCTSEngine::GetSearchOvertimeUs(int64_t timeout_us)
     return 0;
 }
 
-void MCTSEngine::Search()
+template<int N>
+void MCTSEngine<N>::Search()
 {
+    m_is_genmove_searching = true;
     SearchResume();
 
     int64_t timeout_us = GetSearchTimeoutUs();
@@ -730,9 +1111,11 @@ void MCTSEngine::Search()
     SearchWait(overtime_us, true);
 
     SearchPause();
+    m_is_genmove_searching = false;
 }
 
-void MCTSEngine::SearchWait(int64_t timeout_us, bool is_overtime)
+template<int N>
+void MCTSEngine<N>::SearchWait(int64_t timeout_us, bool is_overtime)
 {
     if (timeout_us == 0) {
         return;
@@ -768,7 +1151,8 @@ void MCTSEngine::SearchWait(int64_t timeout_us, bool is_overtime)
     }
 }
 
-void MCTSEngine::SearchResume()
+template<int N>
+void MCTSEngine<N>::SearchResume()
 {
     if (!m_is_searching) {
         m_simulation_counter = 0;
@@ -788,7 +1172,8 @@ void MCTSEngine::SearchResume()
     }
 }
 
-void MCTSEngine::SearchPause()
+template<int N>
+void MCTSEngine<N>::SearchPause()
 {
     if (m_is_searching) {
         m_search_threads_conductor.Pause();
@@ -802,13 +1187,19 @@ void MCTSEngine::SearchPause()
     }
 }
 
-void MCTSEngine::SearchRoutine()
+template<int N>
+void MCTSEngine<N>::SearchRoutine()
 {
     m_search_threads_conductor.Wait();
     if (m_search_threads_conductor.IsTerminate()) {
         LOG(WARNING) << "SearchRoutine: terminate";
         return;
     }
+    // board of this thread stays at root position, moves of each descent are undone by journal
+    GoState board;
+    GoSuperkoHistory superko_history; // positions of descents, on positions of the game
+    GoJournal journal;
+    int board_version = -1;
     for (;;) {
         if (!m_search_threads_conductor.IsRunning()) {
             VLOG(2) << "SearchRoutine pause";
@@ -820,20 +1211,43 @@ void MCTSEngine::SearchRoutine()
                 return;
             }
         }
+        if (m_gc_requested) {
+            TreeGCBarrier();
+            continue;
+        }
+        if (m_tree_size_exceeded) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            CheckTreeSize();
+            continue;
+        }
         Timer timer;
-        auto board = std::make_shared<GoState>(m_board);
-        TreeNode *node = Select(*board);
+        if (board_version != m_board_version) {
+            board.CopyFrom(m_board); // m_board only changes while search paused
+            superko_history.Reset(&m_superko_history);
+            board.SetSuperkoHistory(&superko_history);
+            board_version = m_board_version;
+        }
+        std::vector<uint64_t> path_hashes;
+        float priority;
+        uint32_t node_index;
+        TreeNode *node = Select(board, journal, path_hashes, priority, node_index);
         m_monitor.MonSelectCostMs(timer.fms());
 
-        int expect_unexpanded = k_unexpanded;
-        if (node->expand_state.compare_exchange_strong(expect_unexpanded, k_expanding)) {
-            Eval(*board, [this, node, board, timer](int ret, std::vector<float> policy, float value) {
+        if (node->TrySetExpanding()) {
+            float tt_value = 0.0f;
+            int tt_visit_count = 0;
+            if (m_ttable && node->VisitCount() == 0) {
+                TTableFind(board.GetHashValue(), tt_value, tt_visit_count);
+            }
+            LeafSnapshot<N> leaf(board);
+            Eval(board, [this, node, node_index, leaf, path_hashes, timer, tt_value, tt_visit_count]
+                        (int ret, std::vector<float> policy, float value) {
                 if (ret) {
-                    node->expand_state = k_unexpanded;
+                    node->SetExpandState(k_unexpanded);
                     UndoVirtualLoss(node);
                 } else {
-                    int ch_len = Expand(node, *board, policy);
-                    Backup(node, value, ch_len);
+                    Expand(node, node_index, leaf, policy);
+                    Backup(node, value, path_hashes, tt_value, tt_visit_count);
 
                     ++m_simulation_counter;
                     if (m_config.max_simulations_per_step() > 0 &&
@@ -841,101 +1255,150 @@ void MCTSEngine::SearchRoutine()
                         m_search_threads_conductor.Pause();
                     }
 
-                    if (m_root->size > m_config.max_search_tree_size() &&
-                        m_search_threads_conductor.IsRunning()) {
-                        m_search_threads_conductor.Pause();
-                        LOG(ERROR) << "Expand: node pool exhausted, search pause";
+                    // tree size is summed over counter shards, don't read it every simulation
+                    if (++g_tree_size_check_counter % k_tree_size_check_every == 0) {
+                        CheckTreeSize();
                     }
                 }
                 m_monitor.MonSimulationCostMs(timer.fms());
-            });
+            }, priority);
         } else {
             UndoVirtualLoss(node);
             m_monitor.IncSelectSameNode();
         }
+        while (journal.NumMoves() > 0) {
+            board.Undo(journal);
+        }
     }
 }
 
-void MCTSEngine::ChangeRoot(TreeNode *node)
+template<int N>
+void MCTSEngine<N>::CheckTreeSize()
 {
-    TreeNode *root = new TreeNode;
-    if (node) {
-        root->fa = nullptr;
-        root->size = node->size.load();
-        root->expand_state = node->expand_state.load();
-        root->move = node->move.load();
-        root->visit_count = node->visit_count.load();
-        root->virtual_loss_count = node->virtual_loss_count.load();
-        root->total_action = node->total_action.load();
-        root->prior_prob = node->prior_prob.load();
-        root->value = node->value.load();
-
-        TreeNode *ch = node->ch;
-        int ch_len = node->ch_len;
-        for (int i = 0; i < ch_len; ++i) {
-            ch[i].fa = root;
+    int64_t tree_size = m_node_arena->NumAllocatedNodes();
+
+    if (m_config.tree_gc().enable() && m_num_pending_deletes == 0 && !m_gc_requested) {
+        int64_t max_memory_mb = m_config.tree_gc().max_memory_mb() ? m_config.tree_gc().max_memory_mb() : 1024;
+        if (tree_size * (int64_t)sizeof(TreeNode) > max_memory_mb << 20) {
+            m_gc_requested = true;
         }
-        root->ch = ch;
-        root->ch_len = ch_len;
-        node->ch = nullptr;
-        node->ch_len = 0;
-    } else {
-        InitNode(root, nullptr, -1, 0.0);
     }
 
-    if (m_root) {
-        m_delete_queue.Push(m_root);
+    // nodes of discarded subtrees are counted until delete threads free them,
+    // search waits for them while there are pending deletes, and pauses if the tree itself is too large
+    bool exceeded = tree_size > m_config.max_search_tree_size();
+    if (exceeded && m_num_pending_deletes == 0) {
+        if (m_search_threads_conductor.IsRunning()) {
+            m_search_threads_conductor.Pause();
+            LOG(ERROR) << "Expand: node pool exhausted, search pause";
+        }
+        exceeded = false;
+    }
+    if (m_tree_size_exceeded != exceeded) {
+        m_tree_size_exceeded = exceeded;
+    }
+}
+
+template<int N>
+void MCTSEngine<N>::ChangeRoot(TreeNode *node)
+{
+    uint32_t root_index;
+    if (node) {
+        // children of new root are at depth 1 now
+        bool padded = m_config.node_layout().padded_depth() > 0;
+        if (node->ChLen() > 0 && (node->IsLazy() || node->IsPadded() != padded)) {
+            RebuildChildren(node, padded);
+        }
+        root_index = m_node_arena->Allocate(1);
+        TreeNode *root = m_node_arena->Get(root_index);
+        MoveNode(node, root, root_index);
+        root->fa = 0;
+
+        ++m_num_pending_deletes;
+        m_delete_queue.Push(DeleteTask{m_root_index, 1, false, m_node_arena});
+    } else {
+        // whole tree is discarded, release its arena in bulk instead of deleting node by node
+        std::shared_ptr<TreeNodeArena> arena(new TreeNodeArena);
+        std::swap(arena, m_node_arena);
+        if (m_root) {
+            m_delete_queue.Push(DeleteTask{0, 0, false, std::move(arena)});
+        }
+        root_index = m_node_arena->Allocate(1);
+        InitNode(m_node_arena->Get(root_index), 0, -1, 0.0);
+        TTableClear();
     }
-    m_root = root;
+    m_root = m_node_arena->Get(root_index);
+    m_root_index = root_index;
 }
 
-void MCTSEngine::InitRoot()
+template<int N>
+void MCTSEngine<N>::InitRoot()
 {
     CHECK_NOTNULL(m_root);
-    while (m_root->expand_state == k_unexpanded) {
+    while (m_root->ExpandState() == k_unexpanded) {
         Eval(m_board, [this](int ret, std::vector<float> policy, float value) {
             if (ret) {
                 LOG(ERROR) << "InitRoot: eval root node failed, ret " << ret;
             } else {
-                int ch_len = Expand(m_root, m_board, policy);
-                Backup(m_root, value, ch_len);
+                Expand(m_root, m_root_index, LeafSnapshot<N>(m_board), policy);
+                Backup(m_root, value, {});
             }
         });
         m_eval_tasks_wg.Wait();
     }
     if (m_config.enable_dirichlet_noise()) {
-        TreeNode *ch = m_root->ch;
-        int ch_len = m_root->ch_len;
-        float noise[GoComm::GOBOARD_SIZE + 1];
+        TreeNode *ch[Board::GOBOARD_SIZE + 1];
+        int ch_len = GetChildren(m_root, ch);
+        float noise[Board::GOBOARD_SIZE + 1];
         std::gamma_distribution<float> gamma(m_config.dirichlet_noise_alpha());
         for (int i = 0; i < ch_len; ++i) {
             noise[i] = gamma(g_random_engine);
         }
         float noise_sum = std::accumulate(noise, noise + ch_len, 0.0f);
         for (int i = 0; i < ch_len; ++i) {
-            ch[i].prior_prob = (1 - m_config.dirichlet_noise_ratio()) * ch[i].prior_prob +
-                                m_config.dirichlet_noise_ratio() * noise[i] / noise_sum;
+            ch[i]->SetPriorProb((1 - m_config.dirichlet_noise_ratio()) * ch[i]->PriorProb() +
+                               m_config.dirichlet_noise_ratio() * noise[i] / noise_sum);
         }
         bool dumb_pass = m_board.GetWinner() != m_board.CurrentPlayer();
-        if (dumb_pass && m_root->value < 0.5 && !m_config.disable_double_pass_scoring()) {
+        if (dumb_pass && m_root->Value() < 0.5 && !m_config.disable_double_pass_scoring()) {
             for (int i = 0; i < ch_len; ++i) {
-                if (ch[i].move == GoComm::COORD_PASS) {
-                    ch[i].prior_prob = 1e-5f;
+                if (ch[i]->move == GoComm::COORD_PASS) {
+                    ch[i]->SetPriorProb(1e-5f);
                 }
             }
         }
     }
 }
 
-void MCTSEngine::DeleteRoutine()
+template<int N>
+void MCTSEngine<N>::DeleteRoutine()
 {
+    // while genmove is searching, each delete thread frees at most genmove_nodes_per_ms nodes per ms,
+    // so that reclamation never takes cpu from search threads
+    int nodes_per_ms = m_config.tree_delete().genmove_nodes_per_ms() ? m_config.tree_delete().genmove_nodes_per_ms() : 1000;
+    std::unique_ptr<LeakyBucket> bucket;
+    if (nodes_per_ms > 0) {
+        int tokens = std::max(1, nodes_per_ms * k_delete_refill_period_ms / k_delete_nodes_per_token);
+        bucket.reset(new LeakyBucket(tokens, k_delete_refill_period_ms));
+    }
+
     for (;;) {
-        TreeNode *node;
-        if (m_delete_queue.Pop(node)) {
+        DeleteTask task;
+        if (m_delete_queue.Pop(task)) {
             Timer timer;
-            int size = DeleteTree(node);
-            delete node;
-            LOG(INFO) << "DeleteRoutine: deleted " << size + 1 << " nodes, cost " << timer.fms() << "ms";
+            if (task.block == 0) {
+                int64_t size = task.arena->NumAllocatedNodes();
+                int64_t reserved_mb = task.arena->ReservedBytes() >> 20;
+                task.arena.reset(); // arena is destroyed here, or by the last pending delete task on it
+                m_monitor.MonDeleteNodes(size, timer.fms());
+                VLOG(1) << "DeleteRoutine: released arena of " << size << " nodes, "
+                        << reserved_mb << "MB, cost " << timer.fms() << "ms";
+            } else {
+                int64_t size = DeleteTree(task.block, task.block_len, task.padded, task.arena, bucket.get());
+                --m_num_pending_deletes;
+                m_monitor.MonDeleteNodes(size, timer.fms());
+                VLOG(1) << "DeleteRoutine: deleted " << size << " nodes, cost " << timer.fms() << "ms";
+            }
         } else {
             LOG(WARNING) << "DeleteRoutine: terminate";
             return; // terminate
@@ -943,44 +1406,217 @@ void MCTSEngine::DeleteRoutine()
     }
 }
 
-int MCTSEngine::DeleteTree(TreeNode *node)
+template<int N>
+int64_t MCTSEngine<N>::DeleteTree(uint32_t block, int block_len, bool padded,
+                               const std::shared_ptr<TreeNodeArena> &arena, LeakyBucket *bucket)
 {
-    TreeNode *ch = node->ch;
-    int ch_len = node->ch_len;
-    int size = ch_len;
-    for (int i = 0; i < ch_len; ++i) {
-        size += DeleteTree(&ch[i]);
+    // iterative, stack holds child blocks waiting to be freed
+    std::vector<DeleteTask> blocks = {DeleteTask{block, block_len, padded, nullptr}};
+    int64_t size = 0;
+    int nodes_to_pay = 0;
+    while (!blocks.empty()) {
+        uint32_t b = blocks.back().block;
+        int n = blocks.back().block_len;
+        int stride = blocks.back().padded ? 2 : 1;
+        blocks.pop_back();
+
+        TreeNode *nodes = arena->Get(b);
+        for (int i = 0; i < n * stride; i += stride) {
+            int ch_len = nodes[i].ChLen();
+            if (ch_len == 0) {
+                continue;
+            }
+            if (nodes[i].IsLazy()) {
+                TreeEdge *edges = arena->GetEdges(nodes[i].ch);
+                for (int j = 0; j < ch_len && edges[j].child; ++j) {
+                    blocks.push_back(DeleteTask{edges[j].child, 1, false, nullptr});
+                }
+                int edge_block_size = TreeNodeArena::EdgeBlockSize(ch_len);
+                arena->Free(nodes[i].ch, edge_block_size);
+                size += edge_block_size;
+            } else {
+                blocks.push_back(DeleteTask{nodes[i].ch, ch_len, nodes[i].IsPadded(), nullptr});
+            }
+        }
+        if (stride == 2) {
+            arena->FreePadded(b, n);
+        } else {
+            arena->Free(b, n);
+        }
+        size += n * stride;
+
+        // hand the oldest half of pending blocks (nearest to subtree root, so largest) to idle delete threads
+        if (blocks.size() >= k_delete_split_blocks && m_delete_threads.size() > 1 && m_delete_queue.Size() == 0) {
+            size_t half = blocks.size() / 2;
+            size_t num_kept = 0; // queue closed when engine terminates, blocks not taken are freed here
+            for (size_t i = 0; i < half; ++i) {
+                ++m_num_pending_deletes;
+                blocks[i].arena = arena;
+                if (!m_delete_queue.Push(std::move(blocks[i]))) {
+                    --m_num_pending_deletes;
+                    blocks[num_kept++] = std::move(blocks[i]);
+                }
+            }
+            blocks.erase(blocks.begin() + num_kept, blocks.begin() + half);
+        }
+
+        if (bucket && m_is_genmove_searching && !m_tree_size_exceeded) {
+            for (nodes_to_pay += n * stride; nodes_to_pay >= k_delete_nodes_per_token; nodes_to_pay -= k_delete_nodes_per_token) {
+                bucket->ConsumeToken();
+                if (bucket->Empty()) {
+                    bucket->WaitRefill();
+                }
+            }
+        }
     }
-    delete[] ch;
     return size;
 }
 
-int MCTSEngine::GetBestMove(float &v_resign)
+// Tree GC stops all search threads, then the last one arrived collapses least visited subtrees.
+// Search threads left for pausing come back after resumed, since m_gc_requested is still set.
+template<int N>
+void MCTSEngine<N>::TreeGCBarrier()
 {
-    TreeNode *ch = m_root->ch;
-    int ch_len = m_root->ch_len;
-    int visit_count[GoComm::GOBOARD_SIZE + 1];
-    float total_action[GoComm::GOBOARD_SIZE + 1];
-    float mean_action[GoComm::GOBOARD_SIZE + 1];
-    float prior_prob[GoComm::GOBOARD_SIZE + 1];
-    float value[GoComm::GOBOARD_SIZE + 1];
+    std::unique_lock<std::mutex> lock(m_gc_mutex);
+    int epoch = m_gc_epoch;
+    if (++m_gc_waiting == (int)m_search_threads.size()) {
+        m_eval_tasks_wg.Wait(); // no callback may refer to tree nodes during GC
+        TreeGC();
+        m_gc_waiting = 0;
+        ++m_gc_epoch;
+        m_gc_requested = false;
+        m_gc_cond.notify_all();
+        return;
+    }
+    while (m_gc_epoch == epoch && m_search_threads_conductor.IsRunning()) {
+        m_gc_cond.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    if (m_gc_epoch == epoch) {
+        --m_gc_waiting;
+    }
+}
+
+template<int N>
+void MCTSEngine<N>::TreeGC()
+{
+    auto &c = m_config.tree_gc();
+    int64_t max_memory_mb = c.max_memory_mb() ? c.max_memory_mb() : 1024;
+    float target_ratio = c.target_ratio() ? c.target_ratio() : 0.8f;
+    int64_t num_nodes = m_node_arena->NumAllocatedNodes();
+    int64_t target_nodes = (max_memory_mb << 20) * target_ratio / sizeof(TreeNode);
+    if (num_nodes * (int64_t)sizeof(TreeNode) <= max_memory_mb << 20) {
+        return;
+    }
+
+    // freed[b]: nodes to free if collapsing every expanded node with visit count bucket <= b
+    Timer timer;
+    int64_t freed[k_gc_num_buckets + 1] = {0};
+    TreeGCScan(freed);
+    int max_bucket = 0;
+    for (int64_t sum = freed[0]; max_bucket < k_gc_num_buckets - 1 && num_nodes - sum > target_nodes; ) {
+        sum += freed[++max_bucket];
+        freed[max_bucket] = sum;
+    }
+    int num_collapsed = TreeGCCollapse(max_bucket);
+    LOG(INFO) << "TreeGC: collapsed " << num_collapsed << " subtrees with visit count < " << (1LL << max_bucket)
+              << ", freeing " << freed[max_bucket] << " of " << num_nodes << " nodes, cost " << timer.fms() << "ms";
+}
+
+// freed[b] += nodes under expanded nodes whose bucket is b, bucket of a node is the min visit count bucket
+// of it and its ancestors, so collapsing every node of bucket <= b frees freed[0] + ... + freed[b] nodes.
+// Iterative as DeleteTree, the tree may be deep.
+template<int N>
+void MCTSEngine<N>::TreeGCScan(int64_t *freed)
+{
+    std::vector<std::pair<TreeNode *, int>> nodes = {{m_root, k_gc_num_buckets}};
+    while (!nodes.empty()) {
+        TreeNode *node = nodes.back().first;
+        int bucket = nodes.back().second;
+        nodes.pop_back();
+
+        int ch_len = node->ChLen();
+        if (ch_len == 0) {
+            continue;
+        }
+        if (node != m_root) {
+            bucket = std::min(bucket, VisitBucket(node->VisitCount()));
+        }
+        TreeNode *ch[Board::GOBOARD_SIZE + 1];
+        int num_ch = GetChildren(node, ch);
+        freed[bucket] += node->IsLazy() ? TreeNodeArena::EdgeBlockSize(ch_len) + num_ch : ch_len * node->ChStride();
+        for (int i = 0; i < num_ch; ++i) {
+            nodes.emplace_back(ch[i], bucket);
+        }
+    }
+}
+
+// collapse subtrees back to unexpanded leaves, visit count and total action are kept.
+// Iterative as DeleteTree, stack holds nodes whose children are still to check.
+template<int N>
+int MCTSEngine<N>::TreeGCCollapse(int max_bucket)
+{
+    std::vector<TreeNode *> nodes = {m_root};
+    int num_collapsed = 0;
+    while (!nodes.empty()) {
+        TreeNode *node = nodes.back();
+        nodes.pop_back();
+
+        TreeNode *ch[Board::GOBOARD_SIZE + 1];
+        int ch_len = GetChildren(node, ch);
+        for (int i = 0; i < ch_len; ++i) {
+            if (ch[i]->ChLen() == 0) {
+                continue;
+            }
+            if (VisitBucket(ch[i]->VisitCount()) <= max_bucket) {
+                if (ch[i]->IsLazy()) {
+                    TreeEdge *edges = m_node_arena->GetEdges(ch[i]->ch);
+                    for (int j = 0; j < ch[i]->ChLen() && edges[j].child; ++j) {
+                        ++m_num_pending_deletes;
+                        m_delete_queue.Push(DeleteTask{edges[j].child, 1, false, m_node_arena});
+                    }
+                    m_node_arena->Free(ch[i]->ch, TreeNodeArena::EdgeBlockSize(ch[i]->ChLen()));
+                } else {
+                    ++m_num_pending_deletes;
+                    m_delete_queue.Push(DeleteTask{ch[i]->ch, ch[i]->ChLen(), ch[i]->IsPadded(), m_node_arena});
+                }
+                ch[i]->ch = 0;
+                ch[i]->SetExpandState(k_unexpanded);
+                ++num_collapsed;
+            } else {
+                nodes.push_back(ch[i]);
+            }
+        }
+    }
+    return num_collapsed;
+}
+
+template<int N>
+int MCTSEngine<N>::GetBestMove(float &v_resign)
+{
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(m_root, ch);
+    int visit_count[Board::GOBOARD_SIZE + 1];
+    float total_action[Board::GOBOARD_SIZE + 1];
+    float mean_action[Board::GOBOARD_SIZE + 1];
+    float prior_prob[Board::GOBOARD_SIZE + 1];
+    float value[Board::GOBOARD_SIZE + 1];
     bool disable_pass = IsPassDisable();
     for (int i = 0; i < ch_len; ++i) {
-        if (disable_pass && ch[i].move == GoComm::COORD_PASS) {
+        if (disable_pass && ch[i]->move == GoComm::COORD_PASS) {
             visit_count[i] = 0;
             total_action[i] = 0.0f;
             mean_action[i] = 0.0f;
             prior_prob[i] = 0.0f;
             value[i] = -1.0f;
         } else {
-            visit_count[i] = ch[i].visit_count;
-            total_action[i] = (float)ch[i].total_action / k_action_value_base;
+            visit_count[i] = ch[i]->VisitCount();
+            total_action[i] = (float)ch[i]->total_action / k_action_value_base;
             mean_action[i] = visit_count[i] == 0 ? -1.0f : total_action[i] / visit_count[i];
-            prior_prob[i] = ch[i].prior_prob;
-            value[i] = ch[i].value;
+            prior_prob[i] = ch[i]->PriorProb();
+            value[i] = ch[i]->Value();
         }
 
-        VLOG(2) << "GetBestMove: " << GoFunction::IdToStr(ch[i].move)
+        VLOG(2) << "GetBestMove: " << Board::IdToStr(ch[i]->move)
                 << ", N " << visit_count[i] << ", W " << total_action[i] << ", Q " << mean_action[i]
                 << ", p " << prior_prob[i] << ", v " << value[i];
     }
@@ -994,8 +1630,8 @@ int MCTSEngine::GetBestMove(float &v_resign)
         default: LOG(FATAL) << "GetBestMove: wrong get_best_move_mode " << m_config.get_best_move_mode();
     }
 
-    float root_action = -(float)m_root->total_action / k_action_value_base / m_root->visit_count;
-    float root_value = -m_root->value;
+    float root_action = -(float)m_root->total_action / k_action_value_base / m_root->VisitCount();
+    float root_value = -m_root->Value();
     switch (m_config.resign_mode()) {
         case 0: v_resign = std::max(root_action, mean_action[choice]); break;
         case 1: v_resign = std::max(root_value,        value[choice]); break;
@@ -1009,78 +1645,66 @@ int MCTSEngine::GetBestMove(float &v_resign)
         return GoComm::COORD_RESIGN;
     }
     LOG(INFO) << "GetBestMove: v_resign=" << v_resign << ", not resign";
-    return ch[choice].move;
+    return ch[choice]->move;
 }
 
-int MCTSEngine::GetSamplingMove(float temperature)
+template<int N>
+int MCTSEngine<N>::GetSamplingMove(float temperature)
 {
-    TreeNode *ch = m_root->ch;
-    int ch_len = m_root->ch_len;
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(m_root, ch);
     float rtemp = 1.0f / temperature;
-    float probs[GoComm::GOBOARD_SIZE + 1];
+    float probs[Board::GOBOARD_SIZE + 1];
     bool disable_pass = IsPassDisable();
     for (int i = 0; i < ch_len; ++i) {
-        if (disable_pass && ch[i].move == GoComm::COORD_PASS) {
+        if (disable_pass && ch[i]->move == GoComm::COORD_PASS) {
             probs[i] = 0.0;
         } else {
-            probs[i] = std::pow(ch[i].visit_count, rtemp);
+            probs[i] = std::pow(ch[i]->VisitCount(), rtemp);
         }
     }
     int choice = std::discrete_distribution<>(probs, probs + ch_len)(g_random_engine);
-    return ch[choice].move;
+    return ch[choice]->move;
 }
 
-std::vector<int> MCTSEngine::GetVisitCount(TreeNode *node)
+template<int N>
+std::vector<int> MCTSEngine<N>::GetVisitCount(TreeNode *node)
 {
-    TreeNode *ch = node->ch;
-    int ch_len = node->ch_len;
-    std::vector<int> visit_count(GoComm::GOBOARD_SIZE + 1, 0);
+    TreeNode *ch[Board::GOBOARD_SIZE + 1];
+    int ch_len = GetChildren(node, ch);
+    std::vector<int> visit_count(Board::GOBOARD_SIZE + 1, 0);
     for (int i = 0; i < ch_len; ++i) {
-        int move = ch[i].move;
+        int move = ch[i]->move;
         if (move == GoComm::COORD_PASS) {
-            visit_count.back() = ch[i].visit_count;
+            visit_count.back() = ch[i]->VisitCount();
         } else {
-            visit_count[move] = ch[i].visit_count;
+            visit_count[move] = ch[i]->VisitCount();
         }
     }
     return visit_count;
 }
 
+template<int N>
 template<class T>
-void MCTSEngine::TransformFeatures(T &features, int mode, bool reverse)
+void MCTSEngine<N>::TransformFeatures(T &features, int mode, bool reverse)
 {
     if (m_config.disable_transform()) {
         return;
     }
-
-    T ret(features.size());
-    int depth = features.size() / GoComm::GOBOARD_SIZE;
-    for (int i = 0; i < GoComm::GOBOARD_SIZE; ++i) {
-        GoCoordId x, y;
-        GoFunction::IdToCoord(i, x, y);
-        TransformCoord(x, y, mode, reverse);
-        int j = GoFunction::CoordToId(x, y);
-        for (int k = 0; k < depth; ++k) {
-            ret[i * depth + k] = features[j * depth + k];
-        }
-    }
-    features = std::move(ret);
+    GoSymmetry::TransformFeatures<N>(features, mode, reverse);
 }
 
-void MCTSEngine::TransformCoord(GoCoordId &x, GoCoordId &y, int mode, bool reverse)
+template<int N>
+void MCTSEngine<N>::TransformFeatures(PackedFeatures &features, int mode, bool reverse)
 {
-    if (reverse) {
-        if (mode & 4) std::swap(x, y);
-        if (mode & 2) y = GoComm::BORDER_SIZE - y - 1;
-        if (mode & 1) x = GoComm::BORDER_SIZE - x - 1;
-    } else {
-        if (mode & 1) x = GoComm::BORDER_SIZE - x - 1;
-        if (mode & 2) y = GoComm::BORDER_SIZE - y - 1;
-        if (mode & 4) std::swap(x, y);
+    if (m_config.disable_transform()) {
+        return;
     }
+    GoSymmetry::TransformPlanes<N>(features.planes, PackedFeatures::NUM_PLANES, mode, reverse);
 }
 
-void MCTSEngine::ApplyTemperature(std::vector<float> &probs, float temperature)
+template<int N>
+void MCTSEngine<N>::ApplyTemperature(std::vector<float> &probs, float temperature)
 {
     float rtemp = 1.0f / temperature;
     for (float &p: probs) {
@@ -1092,8 +1716,61 @@ void MCTSEngine::ApplyTemperature(std::vector<float> &probs, float temperature)
     }
 }
 
-bool MCTSEngine::IsPassDisable()
+template<int N>
+void MCTSEngine<N>::TTableUpdate(uint64_t hash, int64_t value)
+{
+    m_ttable->Update(hash, value);
+}
+
+// mean value of the same position searched in other branches, for seeding a new leaf.
+// Only the value is shared, visit counts of the tree stay real ones so that a child never has more visits
+// than its parent, move choice and training targets read them.
+template<int N>
+bool MCTSEngine<N>::TTableFind(uint64_t hash, float &mean_value, int &visit_count)
+{
+    int64_t total_action;
+    if (m_ttable->Find(hash, visit_count, total_action) && visit_count > 0) {
+        mean_value = (float)total_action / k_action_value_base / visit_count;
+        m_monitor.IncTTableHit();
+        return true;
+    }
+    visit_count = 0;
+    m_monitor.IncTTableMiss();
+    return false;
+}
+
+template<int N>
+void MCTSEngine<N>::TTableClear()
+{
+    if (m_ttable) {
+        m_ttable->Clear();
+    }
+}
+
+template<int N>
+void MCTSEngine<N>::EvalCacheInsert(uint64_t hash, const std::vector<float> &policy, float value)
+{
+    m_eval_cache->Insert(hash, policy, value);
+}
+
+template<int N>
+bool MCTSEngine<N>::EvalCacheFind(uint64_t hash, std::vector<float> &policy, float &value)
+{
+    if (m_eval_cache->Find(hash, policy, value)) {
+        m_monitor.IncEvalCacheHit();
+        return true;
+    }
+    m_monitor.IncEvalCacheMiss();
+    return false;
+}
+
+template<int N>
+bool MCTSEngine<N>::IsPassDisable()
 {
     return m_config.disable_pass() ||
            (m_config.max_gen_passes() && m_gen_passes >= m_config.max_gen_passes());
 }
+
+#define MCTS_ENGINE_INSTANTIATE(n) template class MCTSEngine<n>;
+FOR_EACH_BOARD_SIZE(MCTS_ENGINE_INSTANTIATE)
+#undef MCTS_ENGINE_INSTANTIATE
@@ -18,55 +18,82 @@
 #pragma once
 
 #include <atomic>
+#include <cstring>
 #include <vector>
 #include <thread>
 #include <future>
+#include <mutex>
+#include <condition_variable>
 
 #include "common/go_comm.h"
 #include "common/go_state.h"
+#include "common/go_symmetry.h"
 #include "common/task_queue.h"
+#include "common/lock_free_task_queue.h"
+#include "common/priority_task_queue.h"
+#include "common/sharded_counter.h"
 #include "common/wait_group.h"
 #include "common/thread_conductor.h"
 #include "common/timer.h"
 #include "model/zero_model_base.h"
-
+#include "dist/leaky_bucket.h"
+
+#include "tree_node.h"
+#include "tree_node_arena.h"
+#include "transposition_table.h"
+#include "eval_cache.h"
+#include "batch_controller.h"
+#include "pending_eval_table.h"
+#include "feature_slot_pool.h"
+#include "puct.h"
 #include "mcts_config.h"
 #include "mcts_monitor.h"
 #include "mcts_debugger.h"
 #include "byo_yomi_timer.h"
 
-struct TreeNode
+typedef std::function<void(int, std::vector<float>, float)> EvalCallback;
+
+struct EvalTask
 {
-    std::atomic<TreeNode*> fa;
-    std::atomic<TreeNode*> ch; // child nodes must allocate contiguously
-    std::atomic<int> ch_len;
-    std::atomic<int> size;
-    std::atomic<int> expand_state;
-
-    std::atomic<int> move;
-    std::atomic<int> visit_count;
-    std::atomic<int> virtual_loss_count;
-    std::atomic<int64_t> total_action;
-    std::atomic<float> prior_prob;
-    std::atomic<float> value;
+    FeatureSlotPool::Slot *slot; // features, released when the eval is done
+    EvalCallback callback;
+    float priority; // for PriorityTaskQueue, share of root visits through the leaf's parent, 1 for root
 };
 
-const int64_t k_action_value_base = 1 << 16;
-const int k_unexpanded = 0;
-const int k_expanding = 1;
-const int k_expanded = 2;
+static_assert(PackedFeatures::NUM_PLANES == GoFeature::FEATURE_COUNT && PackedFeatures::NUM_WORDS == GoComm::BOARD_STATE_SIZE,
+              "PackedFeatures should match GoState::GetFeaturePlanes");
 
-typedef std::function<void(int, std::vector<float>, float)> EvalCallback;
+// What Expand needs to know about the board of a leaf, eval callback keeps this instead of the board
+template<int N>
+struct LeafSnapshot
+{
+    uint64_t legal_moves[GoBoard<N>::BOARD_STATE_SIZE]; // GoStateT::GetLegalPlane
+    bool is_double_pass;
+
+    explicit LeafSnapshot(const GoStateT<N> &board)
+        : is_double_pass(board.IsDoublePass())
+    {
+        memcpy(legal_moves, board.GetLegalPlane(), sizeof(legal_moves));
+    }
+};
 
-struct EvalTask
+struct DeleteTask
 {
-    std::vector<bool> features;
-    EvalCallback callback;
+    uint32_t block; // delete nodes of block and their subtrees, 0 means release the whole arena
+    int block_len;
+    bool padded;    // allocated by TreeNodeArena::AllocatePadded
+    std::shared_ptr<TreeNodeArena> arena;
 };
 
+// Search on board of border size N, instantiated for sizes of FOR_EACH_BOARD_SIZE,
+// the size is chosen by MCTSConfig.board_size when the engine is created.
+template<int N>
 class MCTSEngine
 {
  public:
+    typedef GoStateT<N> GoState;
+    typedef GoBoard<N> Board;
+
     MCTSEngine(const MCTSConfig &config);
     ~MCTSEngine();
 
@@ -78,21 +105,31 @@ class MCTSEngine
     const GoState &GetBoard();
     MCTSConfig &GetConfig();
     void SetPendingConfig(std::unique_ptr<MCTSConfig> config);
-    MCTSDebugger &GetDebugger();
+    MCTSDebugger<N> &GetDebugger();
     int GetModelGlobalStep();
     ByoYomiTimer &GetByoYomiTimer();
 
  private:
-    TreeNode *InitNode(TreeNode *node, TreeNode *fa, int move, float prior_prob);
+    TreeNode *InitNode(TreeNode *node, uint32_t fa, int move, float prior_prob);
     TreeNode *FindChild(TreeNode *node, int move);
-
-    void Eval(const GoState &board, EvalCallback callback);
+    int GetChildren(TreeNode *node, TreeNode **ch); // only created ones for lazily expanded node
+    TreeNode *CreateChild(uint32_t node_index, TreeEdge *edge, uint32_t &child_index);
+    uint32_t GetNodeIndex(TreeNode *node); // scans edges of a lazy father, hot paths pass indices down instead
+    void SetChildrenFa(TreeNode *node, uint32_t fa);
+    void MoveNode(TreeNode *src, TreeNode *dst, uint32_t dst_index); // only when search paused
+    void RebuildChildren(TreeNode *node, bool padded); // move children to a new eager block, only when search paused
+    int GetNodeDepth(TreeNode *node, int max_depth);
+
+    void Eval(const GoState &board, EvalCallback callback, float priority = 1.0f);
+    bool AttachPendingEval(uint64_t key, EvalCallback &callback); // false if key is not in flight
     void EvalRoutine(std::unique_ptr<ZeroModelBase> model);
 
-    TreeNode *Select(GoState &board);
-    TreeNode *SelectChild(TreeNode *node);
-    int Expand(TreeNode *node, GoState &board, const std::vector<float> &policy);
-    void Backup(TreeNode *node, float value, int ch_len);
+    TreeNode *Select(GoState &board, GoJournal &journal, std::vector<uint64_t> &path_hashes, float &priority,
+                     uint32_t &node_index);
+    TreeNode *SelectChild(TreeNode *node, uint32_t &node_index); // node_index: in node's, out child's
+    int Expand(TreeNode *node, uint32_t node_index, const LeafSnapshot<N> &leaf, const std::vector<float> &policy);
+    void Backup(TreeNode *node, float value, const std::vector<uint64_t> &path_hashes,
+                float tt_value = 0.0f, int tt_weight = 0);
     void UndoVirtualLoss(TreeNode *node);
 
     bool CheckEarlyStop(int64_t timeout_us);
@@ -107,12 +144,19 @@ class MCTSEngine
     void SearchResume();
     void SearchPause();
     void SearchRoutine();
+    void CheckTreeSize();
 
     void ChangeRoot(TreeNode *node);
     void InitRoot();
 
     void DeleteRoutine();
-    int DeleteTree(TreeNode *node);
+    int64_t DeleteTree(uint32_t block, int block_len, bool padded,
+                       const std::shared_ptr<TreeNodeArena> &arena, LeakyBucket *bucket);
+
+    void TreeGCBarrier();
+    void TreeGC();
+    void TreeGCScan(int64_t *freed);
+    int TreeGCCollapse(int max_bucket);
 
     int GetBestMove(float &v_resign);
     int GetSamplingMove(float temperature);
@@ -120,15 +164,15 @@ class MCTSEngine
 
     template<class T>
     void TransformFeatures(T &features, int mode, bool reverse = false);
-    void TransformCoord(GoCoordId &x, GoCoordId &y, int mode, bool reverse = false);
+    void TransformFeatures(PackedFeatures &features, int mode, bool reverse = false);
 
     void ApplyTemperature(std::vector<float> &probs, float temperature);
 
     void TTableUpdate(uint64_t hash, int64_t value);
-    void TTableSync(TreeNode *node);
+    bool TTableFind(uint64_t hash, float &mean_value, int &visit_count);
     void TTableClear();
 
-    void EvalCacheInsert(uint64_t hash, const std::vector<float> policy, float value);
+    void EvalCacheInsert(uint64_t hash, const std::vector<float> &policy, float value);
     bool EvalCacheFind(uint64_t hash, std::vector<float> &policy, float &value);
 
     bool IsPassDisable();
@@ -138,10 +182,20 @@ class MCTSEngine
     std::unique_ptr<MCTSConfig> m_pending_config;
 
     TreeNode *m_root;
+    uint32_t m_root_index;
+    std::shared_ptr<TreeNodeArena> m_node_arena;
     GoState m_board;
+    GoSuperkoHistory m_superko_history; // positions of m_board's game, shared by search threads as base history
+    std::atomic<int> m_board_version; // search threads resync their boards when it changes
+
+    std::unique_ptr<TranspositionTable> m_ttable;
+    std::unique_ptr<EvalCache> m_eval_cache;
+    std::unique_ptr<PendingEvalTable<EvalCallback>> m_pending_evals;
 
     std::vector<std::thread> m_eval_threads;
-    TaskQueue<EvalTask> m_eval_task_queue;
+    FeatureSlotPool m_feature_slots;
+    std::unique_ptr<TaskQueueBase<EvalTask>> m_eval_task_queue;
+    ShardedCounter m_eval_arrivals; // tasks pushed to m_eval_task_queue, for BatchController
     WaitGroup m_eval_threads_init_wg;
     WaitGroup m_eval_tasks_wg;
     std::atomic<int> m_model_global_step;
@@ -149,9 +203,18 @@ class MCTSEngine
     std::vector<std::thread> m_search_threads;
     ThreadConductor m_search_threads_conductor;
     bool m_is_searching;
+    std::atomic<bool> m_is_genmove_searching;
 
-    std::thread m_delete_thread;
-    TaskQueue<TreeNode*> m_delete_queue;
+    std::vector<std::thread> m_delete_threads;
+    TaskQueue<DeleteTask> m_delete_queue;
+    std::atomic<int> m_num_pending_deletes;
+    std::atomic<bool> m_tree_size_exceeded; // search threads wait for delete threads, which stop rate limiting
+
+    std::atomic<bool> m_gc_requested;
+    std::mutex m_gc_mutex;
+    std::condition_variable m_gc_cond;
+    int m_gc_waiting;
+    int m_gc_epoch;
 
     std::atomic<int> m_simulation_counter;
     Timer m_search_timer;
@@ -163,9 +226,13 @@ class MCTSEngine
 
     ByoYomiTimer m_byo_yomi_timer;
 
-    MCTSMonitor m_monitor;
-    MCTSDebugger m_debugger;
+    MCTSMonitor<N> m_monitor;
+    MCTSDebugger<N> m_debugger;
 
-    friend class MCTSMonitor;
-    friend class MCTSDebugger;
+    friend class MCTSMonitor<N>;
+    friend class MCTSDebugger<N>;
 };
+
+#define MCTS_ENGINE_EXTERN_TEMPLATE(n) extern template class MCTSEngine<n>;
+FOR_EACH_BOARD_SIZE(MCTS_ENGINE_EXTERN_TEMPLATE)
+#undef MCTS_ENGINE_EXTERN_TEMPLATE
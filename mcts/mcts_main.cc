@@ -43,9 +43,6 @@ DEFINE_string(allow_ip, "", "List of client ip allowed to connect, seperated by
 DEFINE_bool(fork_per_request, true, "Fork for each request or not.");
 #endif
 
-const int k_handicaps_x[5] = {3, 15, 15, 3, 9};
-const int k_handicaps_y[5] = {3, 15, 3, 15, 9};
-
 std::unique_ptr<MCTSConfig> InitConfig(const std::string &config_path)
 {
     auto config = LoadConfig(config_path);
@@ -68,21 +65,41 @@ std::unique_ptr<MCTSConfig> InitConfig(const std::string &config_path)
     return config;
 }
 
-std::unique_ptr<MCTSEngine> InitEngine(const std::string &config_path)
+int BoardSize(const MCTSConfig &config)
+{
+    return config.board_size() ? config.board_size() : GoComm::BORDER_SIZE;
+}
+
+std::unique_ptr<MCTSConfig> InitEngineConfig(const std::string &config_path)
 {
     auto config = InitConfig(config_path);
     CHECK(config != nullptr) << "Load mcts config file '" << config_path << "' failed";
     LOG(INFO) << "load config succ: \n" << config->DebugString();
-    return std::unique_ptr<MCTSEngine>(new MCTSEngine(*config));
+    return config;
 }
 
-void ReloadConfig(MCTSEngine &engine, const std::string &config_path)
+template<int N>
+std::unique_ptr<MCTSEngine<N>> InitEngine(const MCTSConfig &config)
+{
+    std::unique_ptr<MCTSEngine<N>> engine(new MCTSEngine<N>(config));
+    if (FLAGS_init_moves.size()) {
+        engine->Reset(FLAGS_init_moves);
+    }
+    return engine;
+}
+
+template<int N>
+void ReloadConfig(MCTSEngine<N> &engine, const std::string &config_path)
 {
     auto config = InitConfig(config_path);
     if (config == nullptr) {
         LOG(ERROR) << "Load mcts config file '" << config_path << "' failed";
         return;
     }
+    if (BoardSize(*config) != N) {
+        LOG(WARNING) << "board_size can not be changed by reload, keep " << N;
+    }
+    config->set_board_size(engine.GetConfig().board_size());
     if (google::protobuf::util::MessageDifferencer::Equals(engine.GetConfig(), *config)) {
         LOG(INFO) << "Config hasn't changed";
     } else {
@@ -124,7 +141,19 @@ GoStoneColor DecodeColor(const std::string &s)
     return GoComm::COLOR_UNKNOWN;
 }
 
-std::pair<bool, std::string> GTPExecute(MCTSEngine &engine, const std::string &cmd)
+// handicap stones on star points, corners first then tengen
+template<int N>
+void HandicapMove(int i, GoCoordId &x, GoCoordId &y)
+{
+    const int lo = N >= 13 ? 3 : 2, hi = N - 1 - lo, mid = N / 2;
+    const int handicaps_x[5] = {lo, hi, hi, lo, mid};
+    const int handicaps_y[5] = {lo, hi, lo, hi, mid};
+    x = handicaps_x[i];
+    y = handicaps_y[i];
+}
+
+template<int N>
+std::pair<bool, std::string> GTPExecute(MCTSEngine<N> &engine, const std::string &cmd)
 {
     std::string op;
     std::istringstream ss(cmd);
@@ -151,7 +180,7 @@ std::pair<bool, std::string> GTPExecute(MCTSEngine &engine, const std::string &c
     if (op == "boardsize") {
         int size;
         ss >> size;
-        if (size != 19) {
+        if (size != N) {
             return {false, "unacceptable size"};
         }
         engine.Reset();
@@ -196,8 +225,8 @@ std::pair<bool, std::string> GTPExecute(MCTSEngine &engine, const std::string &c
         std::string output;
         for (int i = 0; i < num_handicap; i++) {
             if (i > 0) engine.Move(-1, -1);
-            int x = k_handicaps_x[i];
-            int y = k_handicaps_y[i];
+            GoCoordId x, y;
+            HandicapMove<N>(i, x, y);
             engine.Move(x, y);
             if (output.size()) output += " ";
             output = EncodeMove(x, y);
@@ -260,12 +289,10 @@ std::pair<bool, std::string> GTPExecute(MCTSEngine &engine, const std::string &c
     return {false, "unknown command"};
 }
 
-void GTPServing(std::istream &in, std::ostream &out)
+template<int N>
+void GTPServing(const MCTSConfig &config, std::istream &in, std::ostream &out)
 {
-    auto engine = InitEngine(FLAGS_config_path);
-    if (FLAGS_init_moves.size()) {
-        engine->Reset(FLAGS_init_moves);
-    }
+    auto engine = InitEngine<N>(config);
     std::cerr << std::flush;
 
     int id;
@@ -302,12 +329,10 @@ void GTPServing(std::istream &in, std::ostream &out)
     LOG(WARNING) << "exiting gtp serving";
 }
 
-void GenMoveOnce()
+template<int N>
+void GenMoveOnce(const MCTSConfig &config)
 {
-    auto engine = InitEngine(FLAGS_config_path);
-    if (FLAGS_init_moves.size()) {
-        engine->Reset(FLAGS_init_moves);
-    }
+    auto engine = InitEngine<N>(config);
 
     GoCoordId x, y;
     engine->GenMove(x, y);
@@ -316,6 +341,29 @@ void GenMoveOnce()
            (int)x, (int)y, engine->GetDebugger().GetLastMoveDebugStr().c_str());
 }
 
+// engine is instantiated for each size of FOR_EACH_BOARD_SIZE, run the one of board_size in config
+void GTPServing(std::istream &in, std::ostream &out)
+{
+    auto config = InitEngineConfig(FLAGS_config_path);
+    switch (BoardSize(*config)) {
+        case 9:  GTPServing<9>(*config, in, out); break;
+        case 13: GTPServing<13>(*config, in, out); break;
+        case 19: GTPServing<19>(*config, in, out); break;
+        default: LOG(FATAL) << "unsupported board_size " << config->board_size();
+    }
+}
+
+void GenMoveOnce()
+{
+    auto config = InitEngineConfig(FLAGS_config_path);
+    switch (BoardSize(*config)) {
+        case 9:  GenMoveOnce<9>(*config); break;
+        case 13: GenMoveOnce<13>(*config); break;
+        case 19: GenMoveOnce<19>(*config); break;
+        default: LOG(FATAL) << "unsupported board_size " << config->board_size();
+    }
+}
+
 void GTPServingOnPort(int port)
 {
     asio::io_service io_service;
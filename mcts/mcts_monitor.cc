@@ -21,12 +21,17 @@
 
 #include "mcts_engine.h"
 
-int MCTSMonitor::g_next_monitor_id = 0;
-MCTSMonitor *MCTSMonitor::g_global_monitors[k_max_monitor_instances];
-std::mutex MCTSMonitor::g_global_monitors_mutex;
-thread_local std::shared_ptr<LocalMonitor> MCTSMonitor::g_local_monitors[k_max_monitor_instances];
+template<int N>
+int MCTSMonitor<N>::g_next_monitor_id = 0;
+template<int N>
+MCTSMonitor<N> *MCTSMonitor<N>::g_global_monitors[k_max_monitor_instances];
+template<int N>
+std::mutex MCTSMonitor<N>::g_global_monitors_mutex;
+template<int N>
+thread_local std::shared_ptr<LocalMonitor> MCTSMonitor<N>::g_local_monitors[k_max_monitor_instances];
 
-MCTSMonitor::MCTSMonitor(MCTSEngine *engine)
+template<int N>
+MCTSMonitor<N>::MCTSMonitor(MCTSEngine<N> *engine)
     : m_engine(engine), m_slot(0)
 {
     {
@@ -41,7 +46,8 @@ MCTSMonitor::MCTSMonitor(MCTSEngine *engine)
     }
 }
 
-MCTSMonitor::~MCTSMonitor()
+template<int N>
+MCTSMonitor<N>::~MCTSMonitor()
 {
     if (m_monitor_thread.joinable()) {
         m_monitor_thread_conductor.Terminate();
@@ -52,13 +58,15 @@ MCTSMonitor::~MCTSMonitor()
     g_global_monitors[m_slot] = nullptr;
 }
 
-void MCTSMonitor::Pause()
+template<int N>
+void MCTSMonitor<N>::Pause()
 {
     m_monitor_thread_conductor.Pause();
     m_monitor_thread_conductor.Join();
 }
 
-void MCTSMonitor::Resume()
+template<int N>
+void MCTSMonitor<N>::Resume()
 {
     if (m_engine->GetConfig().monitor_log_every_ms() > 0) {
         if (!m_monitor_thread.joinable()) {
@@ -68,7 +76,8 @@ void MCTSMonitor::Resume()
     }
 }
 
-void MCTSMonitor::Reset()
+template<int N>
+void MCTSMonitor<N>::Reset()
 {
     std::lock_guard<std::mutex> lock(m_local_monitors_mutex);
     for (auto &local_monitor: m_local_monitors) {
@@ -80,7 +89,8 @@ void MCTSMonitor::Reset()
         m_local_monitors.end());
 }
 
-void MCTSMonitor::Log()
+template<int N>
+void MCTSMonitor<N>::Log()
 {
     VLOG(0) << "MCTSMonitor: avg eval cost " << AvgEvalCostMs() << "ms";
     VLOG(0) << "MCTSMonitor: max eval cost " << MaxEvalCostMs() << "ms";
@@ -101,13 +111,37 @@ void MCTSMonitor::Log()
     VLOG(0) << "MCTSMonitor: avg height of nodes is " << AvgSearchTreeHeight();
     VLOG(0) << "MCTSMonitor: avg eval task queue size is " << AvgTaskQueueSize();
 
+    TreeNodeArena *arena = m_engine->m_node_arena.get();
+    if (arena) {
+        VLOG(0) << "MCTSMonitor: tree arena " << arena->NumAllocatedNodes() << " nodes in use, "
+                << arena->NumFreeNodes() << " nodes in free lists, "
+                << arena->NumReservedNodes() << " nodes reserved (" << (arena->ReservedBytes() >> 20) << "MB)";
+    }
+
+    int64_t deleted_nodes = DeletedNodes();
+    float delete_cost_ms = DeleteCostMs();
+    VLOG(0) << "MCTSMonitor: delete backlog " << m_engine->m_num_pending_deletes << " tasks, deleted "
+            << deleted_nodes << " nodes, " << (delete_cost_ms > 0 ? deleted_nodes / delete_cost_ms : 0) << " nodes/ms";
+
+    if (m_engine->m_ttable) {
+        VLOG(0) << "MCTSMonitor: transposition table hit " << TTableHit() << " times, miss " << TTableMiss() << " times";
+    }
+
+    if (m_engine->m_eval_cache) {
+        VLOG(0) << "MCTSMonitor: eval cache hit " << EvalCacheHit() << " times, miss " << EvalCacheMiss() << " times";
+    }
+
+    if (m_engine->m_pending_evals) {
+        VLOG(0) << "MCTSMonitor: eval coalesced with in flight ones " << EvalCoalesced() << " times";
+    }
 
     if (m_engine->GetConfig().enable_async()) {
         VLOG(0) << "MCTSMonitor: avg rpc queue size is " << AvgRpcQueueSize();
     }
 }
 
-void MCTSMonitor::MonitorRoutine()
+template<int N>
+void MCTSMonitor<N>::MonitorRoutine()
 {
     m_monitor_thread_conductor.Wait();
     for (;;) {
@@ -126,3 +160,7 @@ void MCTSMonitor::MonitorRoutine()
         google::FlushLogFiles(google::GLOG_INFO);
     }
 }
+
+#define MCTS_MONITOR_INSTANTIATE(n) template class MCTSMonitor<n>;
+FOR_EACH_BOARD_SIZE(MCTS_MONITOR_INSTANTIATE)
+#undef MCTS_MONITOR_INSTANTIATE
@@ -26,7 +26,7 @@
 
 class LocalMonitor
 {
-    friend class MCTSMonitor;
+    template<int N> friend class MCTSMonitor;
 
     struct Average
     {
@@ -70,6 +70,17 @@ class LocalMonitor
 
         m_select_same_node = 0;
 
+        m_ttable_hit = 0;
+        m_ttable_miss = 0;
+
+        m_eval_cache_hit = 0;
+        m_eval_cache_miss = 0;
+
+        m_eval_coalesced = 0;
+
+        m_deleted_nodes = 0;
+        m_delete_cost_ms = 0;
+
         m_max_tree_height = 0;
         m_avg_tree_height = 0;
 
@@ -129,6 +140,37 @@ class LocalMonitor
         ++m_select_same_node;
     }
 
+    void IncTTableHit()
+    {
+        ++m_ttable_hit;
+    }
+
+    void IncTTableMiss()
+    {
+        ++m_ttable_miss;
+    }
+
+    void IncEvalCacheHit()
+    {
+        ++m_eval_cache_hit;
+    }
+
+    void IncEvalCacheMiss()
+    {
+        ++m_eval_cache_miss;
+    }
+
+    void IncEvalCoalesced()
+    {
+        ++m_eval_coalesced;
+    }
+
+    void MonDeleteNodes(int64_t nodes, float cost_ms)
+    {
+        m_deleted_nodes += nodes;
+        m_delete_cost_ms += cost_ms;
+    }
+
     void MonSearchTreeHeight(int height)
     {
         UpdateMax(m_max_tree_height, height);
@@ -172,6 +214,17 @@ class LocalMonitor
 
     int m_select_same_node;
 
+    int m_ttable_hit;
+    int m_ttable_miss;
+
+    int m_eval_cache_hit;
+    int m_eval_cache_miss;
+
+    int m_eval_coalesced;
+
+    int64_t m_deleted_nodes;
+    float m_delete_cost_ms;
+
     int m_max_tree_height;
     Average m_avg_tree_height;
 
@@ -180,11 +233,12 @@ class LocalMonitor
     Average m_avg_rpc_queue_size;
 };
 
-class MCTSEngine;
+template<int N> class MCTSEngine;
+template<int N>
 class MCTSMonitor
 {
  public:
-    MCTSMonitor(MCTSEngine *engine);
+    MCTSMonitor(MCTSEngine<N> *engine);
     ~MCTSMonitor();
 
     void Pause();
@@ -243,6 +297,12 @@ class MCTSMonitor
     void MonEvalBatchSize(int batch_size)     { GetLocal().MonEvalBatchSize(batch_size); }
     void IncEvalTimeout()                     { GetLocal().IncEvalTimeout(); }
     void IncSelectSameNode()                  { GetLocal().IncSelectSameNode(); }
+    void IncTTableHit()                       { GetLocal().IncTTableHit(); }
+    void IncTTableMiss()                      { GetLocal().IncTTableMiss(); }
+    void IncEvalCacheHit()                    { GetLocal().IncEvalCacheHit(); }
+    void IncEvalCacheMiss()                   { GetLocal().IncEvalCacheMiss(); }
+    void IncEvalCoalesced()                   { GetLocal().IncEvalCoalesced(); }
+    void MonDeleteNodes(int64_t nodes, float cost_ms) { GetLocal().MonDeleteNodes(nodes, cost_ms); }
     void MonSearchTreeHeight(int height)      { GetLocal().MonSearchTreeHeight(height); }
     void MonTaskQueueSize(int size)           { GetLocal().MonTaskQueueSize(size); }
     void MonRpcQueueSize(int size)            { GetLocal().MonRpcQueueSize(size); }
@@ -262,13 +322,20 @@ class MCTSMonitor
     float AvgEvalBatchSize()      { return GetGlobalAvg(&LocalMonitor::m_avg_batch_size); }
     int   EvalTimeout()           { return GetGlobalSum(&LocalMonitor::m_eval_timeout); }
     int   SelectSameNode()        { return GetGlobalSum(&LocalMonitor::m_select_same_node); }
+    int   TTableHit()             { return GetGlobalSum(&LocalMonitor::m_ttable_hit); }
+    int   TTableMiss()            { return GetGlobalSum(&LocalMonitor::m_ttable_miss); }
+    int   EvalCacheHit()          { return GetGlobalSum(&LocalMonitor::m_eval_cache_hit); }
+    int   EvalCacheMiss()         { return GetGlobalSum(&LocalMonitor::m_eval_cache_miss); }
+    int   EvalCoalesced()         { return GetGlobalSum(&LocalMonitor::m_eval_coalesced); }
+    int64_t DeletedNodes()        { return GetGlobalSum(&LocalMonitor::m_deleted_nodes); }
+    float DeleteCostMs()          { return GetGlobalSum(&LocalMonitor::m_delete_cost_ms); }
     int   MaxSearchTreeHeight()   { return GetGlobalMax(&LocalMonitor::m_max_tree_height); }
     float AvgSearchTreeHeight()   { return GetGlobalAvg(&LocalMonitor::m_avg_tree_height); }
     float AvgTaskQueueSize()      { return GetGlobalAvg(&LocalMonitor::m_avg_task_queue_size); }
     float AvgRpcQueueSize()       { return GetGlobalAvg(&LocalMonitor::m_avg_rpc_queue_size); }
 
  private:
-    MCTSEngine *m_engine;
+    MCTSEngine<N> *m_engine;
     std::thread m_monitor_thread;
     ThreadConductor m_monitor_thread_conductor;
 
@@ -0,0 +1,80 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Evaluations in flight, keyed by GoState::GetHistoryHashValue().
+// A request for a position already being evaluated attaches its callback to the outstanding one
+// instead of submitting another forward. Keys are split into stripes with a mutex each.
+template<class Callback>
+class PendingEvalTable
+{
+ public:
+    PendingEvalTable(int num_stripes)
+        : m_num_stripes(num_stripes), m_stripes(new Stripe[num_stripes])
+    {
+    }
+
+    // If key is in flight, attaches make_callback() to it and returns true.
+    // Otherwise marks key in flight and returns false, the caller evaluates it and calls Complete.
+    template<class MakeCallback>
+    bool Attach(uint64_t key, MakeCallback make_callback)
+    {
+        Stripe &stripe = GetStripe(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.pending.find(key);
+        if (it == stripe.pending.end()) {
+            stripe.pending.emplace(key, std::vector<Callback>());
+            return false;
+        }
+        it->second.push_back(make_callback());
+        return true;
+    }
+
+    // callbacks attached to key, key is not in flight any more
+    std::vector<Callback> Complete(uint64_t key)
+    {
+        Stripe &stripe = GetStripe(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        std::vector<Callback> callbacks;
+        auto it = stripe.pending.find(key);
+        if (it != stripe.pending.end()) {
+            callbacks.swap(it->second);
+            stripe.pending.erase(it);
+        }
+        return callbacks;
+    }
+
+ private:
+    struct Stripe
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::vector<Callback>> pending;
+    };
+
+    Stripe &GetStripe(uint64_t key) { return m_stripes[key % m_num_stripes]; }
+
+ private:
+    int m_num_stripes;
+    std::unique_ptr<Stripe[]> m_stripes;
+};
@@ -0,0 +1,201 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "puct.h"
+
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template<int k_mode>
+inline float PuctScore(const PuctStats &s, int i, float c_puct, float sqrt_sigma_visit_count, float default_act)
+{
+    float n = s.visit_count[i], vl = s.virtual_loss[i], w = s.total_action[i];
+    float act;
+    if (n == 0 && vl == 0) {
+        act = default_act;
+    } else if ((k_mode & 2) == 0) {
+        act = (w - vl) / (n + vl);
+    } else {
+        act = w / n;
+    }
+    float ucb;
+    if ((k_mode & 1) == 0) {
+        ucb = c_puct * s.prior_prob[i] * sqrt_sigma_visit_count / (1 + n + vl);
+    } else {
+        ucb = c_puct * s.prior_prob[i] * sqrt_sigma_visit_count / (1 + n);
+    }
+    return act + ucb;
+}
+
+template<int k_mode>
+int PuctSelectScalarImpl(const PuctStats &s, float c_puct, float sqrt_sigma_visit_count, float default_act,
+                         float &best_score)
+{
+    int best = -1;
+    best_score = -INFINITY;
+    for (int i = 0; i < s.size; ++i) {
+        float score = PuctScore<k_mode>(s, i, c_puct, sqrt_sigma_visit_count, default_act);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// merge per lane results, each lane keeps its first max
+inline int ReduceLanes(const float *scores, const int *indexes, int num_lanes, float &best_score)
+{
+    int best = -1;
+    best_score = -INFINITY;
+    for (int i = 0; i < num_lanes; ++i) {
+        if (indexes[i] >= 0 && (best < 0 || scores[i] > best_score ||
+                                (scores[i] == best_score && indexes[i] < best))) {
+            best_score = scores[i];
+            best = indexes[i];
+        }
+    }
+    return best;
+}
+
+#if defined(__AVX2__)
+
+template<int k_mode>
+int PuctSelectSimdImpl(const PuctStats &s, float c_puct, float sqrt_sigma_visit_count, float default_act,
+                       float &best_score)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 v_c_puct = _mm256_set1_ps(c_puct);
+    const __m256 v_sqrt_sigma = _mm256_set1_ps(sqrt_sigma_visit_count);
+    const __m256 v_default_act = _mm256_set1_ps(default_act);
+    const __m256i v_size = _mm256_set1_epi32(s.size);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256 v_best = _mm256_set1_ps(-INFINITY);
+    __m256i v_best_idx = _mm256_set1_epi32(-1);
+    __m256i v_idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int i = 0; i < s.size; i += 8) {
+        __m256 n = _mm256_loadu_ps(s.visit_count + i);
+        __m256 vl = _mm256_loadu_ps(s.virtual_loss + i);
+        __m256 w = _mm256_loadu_ps(s.total_action + i);
+        __m256 p = _mm256_loadu_ps(s.prior_prob + i);
+
+        __m256 act = (k_mode & 2) == 0 ? _mm256_div_ps(_mm256_sub_ps(w, vl), _mm256_add_ps(n, vl))
+                                       : _mm256_div_ps(w, n);
+        __m256 unvisited = _mm256_and_ps(_mm256_cmp_ps(n, zero, _CMP_EQ_OQ), _mm256_cmp_ps(vl, zero, _CMP_EQ_OQ));
+        act = _mm256_blendv_ps(act, v_default_act, unvisited);
+
+        __m256 denom = (k_mode & 1) == 0 ? _mm256_add_ps(_mm256_add_ps(one, n), vl) : _mm256_add_ps(one, n);
+        __m256 ucb = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(v_c_puct, p), v_sqrt_sigma), denom);
+        __m256 score = _mm256_add_ps(act, ucb);
+
+        __m256 valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(v_size, v_idx));
+        __m256 better = _mm256_and_ps(_mm256_cmp_ps(score, v_best, _CMP_GT_OQ), valid);
+        v_best = _mm256_blendv_ps(v_best, score, better);
+        v_best_idx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(v_best_idx),
+                                                          _mm256_castsi256_ps(v_idx), better));
+        v_idx = _mm256_add_epi32(v_idx, step);
+    }
+    alignas(32) float scores[8];
+    alignas(32) int indexes[8];
+    _mm256_store_ps(scores, v_best);
+    _mm256_store_si256((__m256i*)indexes, v_best_idx);
+    return ReduceLanes(scores, indexes, 8, best_score);
+}
+
+#elif defined(__SSE4_1__)
+
+template<int k_mode>
+int PuctSelectSimdImpl(const PuctStats &s, float c_puct, float sqrt_sigma_visit_count, float default_act,
+                       float &best_score)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 v_c_puct = _mm_set1_ps(c_puct);
+    const __m128 v_sqrt_sigma = _mm_set1_ps(sqrt_sigma_visit_count);
+    const __m128 v_default_act = _mm_set1_ps(default_act);
+    const __m128i v_size = _mm_set1_epi32(s.size);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128 v_best = _mm_set1_ps(-INFINITY);
+    __m128i v_best_idx = _mm_set1_epi32(-1);
+    __m128i v_idx = _mm_setr_epi32(0, 1, 2, 3);
+    for (int i = 0; i < s.size; i += 4) {
+        __m128 n = _mm_loadu_ps(s.visit_count + i);
+        __m128 vl = _mm_loadu_ps(s.virtual_loss + i);
+        __m128 w = _mm_loadu_ps(s.total_action + i);
+        __m128 p = _mm_loadu_ps(s.prior_prob + i);
+
+        __m128 act = (k_mode & 2) == 0 ? _mm_div_ps(_mm_sub_ps(w, vl), _mm_add_ps(n, vl)) : _mm_div_ps(w, n);
+        __m128 unvisited = _mm_and_ps(_mm_cmpeq_ps(n, zero), _mm_cmpeq_ps(vl, zero));
+        act = _mm_blendv_ps(act, v_default_act, unvisited);
+
+        __m128 denom = (k_mode & 1) == 0 ? _mm_add_ps(_mm_add_ps(one, n), vl) : _mm_add_ps(one, n);
+        __m128 ucb = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(v_c_puct, p), v_sqrt_sigma), denom);
+        __m128 score = _mm_add_ps(act, ucb);
+
+        __m128 valid = _mm_castsi128_ps(_mm_cmpgt_epi32(v_size, v_idx));
+        __m128 better = _mm_and_ps(_mm_cmpgt_ps(score, v_best), valid);
+        v_best = _mm_blendv_ps(v_best, score, better);
+        v_best_idx = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(v_best_idx), _mm_castsi128_ps(v_idx), better));
+        v_idx = _mm_add_epi32(v_idx, step);
+    }
+    alignas(16) float scores[4];
+    alignas(16) int indexes[4];
+    _mm_store_ps(scores, v_best);
+    _mm_store_si128((__m128i*)indexes, v_best_idx);
+    return ReduceLanes(scores, indexes, 4, best_score);
+}
+
+#else
+
+template<int k_mode>
+int PuctSelectSimdImpl(const PuctStats &s, float c_puct, float sqrt_sigma_visit_count, float default_act,
+                       float &best_score)
+{
+    return PuctSelectScalarImpl<k_mode>(s, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+}
+
+#endif
+
+} // namespace
+
+int PuctSelect(const PuctStats &stats, int virtual_loss_mode, float c_puct, float sqrt_sigma_visit_count,
+               float default_act, float &best_score)
+{
+    switch (virtual_loss_mode & 3) {
+        case 0: return PuctSelectSimdImpl<0>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        case 1: return PuctSelectSimdImpl<1>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        case 2: return PuctSelectSimdImpl<2>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        default: return PuctSelectSimdImpl<3>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+    }
+}
+
+int PuctSelectScalar(const PuctStats &stats, int virtual_loss_mode, float c_puct, float sqrt_sigma_visit_count,
+                     float default_act, float &best_score)
+{
+    switch (virtual_loss_mode & 3) {
+        case 0: return PuctSelectScalarImpl<0>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        case 1: return PuctSelectScalarImpl<1>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        case 2: return PuctSelectScalarImpl<2>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+        default: return PuctSelectScalarImpl<3>(stats, c_puct, sqrt_sigma_visit_count, default_act, best_score);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "common/go_comm.h"
+
+// Structure of arrays snapshot of children stats, input of PUCT selection.
+// Kernels use unaligned loads, alignment only helps snapshots on stack.
+struct PuctStats
+{
+    static const int k_capacity = (GoComm::GOBOARD_SIZE + 1 + 7) / 8 * 8;
+
+    alignas(32) float visit_count[k_capacity];
+    alignas(32) float virtual_loss[k_capacity];
+    alignas(32) float total_action[k_capacity];
+    alignas(32) float prior_prob[k_capacity];
+    int size;
+
+    // zero the tail of last SIMD vector, lanes after size are masked out anyway
+    void PadTail()
+    {
+        for (int i = size; i < (size + 7) / 8 * 8; ++i) {
+            visit_count[i] = virtual_loss[i] = total_action[i] = prior_prob[i] = 0.0f;
+        }
+    }
+};
+
+// Returns index of the child with max PUCT score and stores the score in best_score,
+// -1 if no child or all scores are NaN. Ties are broken by the smaller index.
+// Children with zero visit and zero virtual loss take default_act as action value.
+// virtual_loss_mode: bit 0 excludes virtual loss from exploration term, bit 1 excludes it from action value.
+int PuctSelect(const PuctStats &stats, int virtual_loss_mode, float c_puct, float sqrt_sigma_visit_count,
+               float default_act, float &best_score);
+
+// Reference implementation without SIMD, same result as PuctSelect.
+int PuctSelectScalar(const PuctStats &stats, int virtual_loss_mode, float c_puct, float sqrt_sigma_visit_count,
+                     float default_act, float &best_score);
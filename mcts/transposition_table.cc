@@ -0,0 +1,85 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "transposition_table.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+TranspositionTable::TranspositionTable(int64_t max_memory_bytes, int num_shards)
+    : m_num_shards(num_shards),
+      m_shards(new Shard[num_shards]),
+      m_generation(1)
+{
+    CHECK_GT(num_shards, 0) << "TranspositionTable: invalid num_shards " << num_shards;
+    m_shard_size = std::max<int64_t>(max_memory_bytes / sizeof(Entry) / num_shards, k_probe_len);
+    for (int i = 0; i < m_num_shards; ++i) {
+        m_shards[i].entries.assign(m_shard_size, Entry{0, 0, 0, 0});
+    }
+    LOG(INFO) << "TranspositionTable: " << Capacity() << " entries in " << m_num_shards << " shards, "
+              << (MemoryBytes() >> 20) << "MB";
+}
+
+void TranspositionTable::Update(uint64_t hash, int64_t action)
+{
+    uint32_t generation = m_generation;
+    Shard &shard = GetShard(hash);
+    size_t slot = GetSlot(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry *victim = nullptr;
+    for (int i = 0; i < k_probe_len; ++i) {
+        Entry &entry = shard.entries[(slot + i) % m_shard_size];
+        if (entry.generation != generation) {
+            if (victim == nullptr || victim->generation == generation) {
+                victim = &entry;
+            }
+            continue;
+        }
+        if (entry.hash == hash) {
+            ++entry.visit_count;
+            entry.total_action += action;
+            return;
+        }
+        if (victim == nullptr || (victim->generation == generation && entry.visit_count < victim->visit_count)) {
+            victim = &entry;
+        }
+    }
+    *victim = Entry{hash, generation, 1, action};
+}
+
+bool TranspositionTable::Find(uint64_t hash, int &visit_count, int64_t &total_action)
+{
+    uint32_t generation = m_generation;
+    Shard &shard = GetShard(hash);
+    size_t slot = GetSlot(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (int i = 0; i < k_probe_len; ++i) {
+        const Entry &entry = shard.entries[(slot + i) % m_shard_size];
+        if (entry.generation == generation && entry.hash == hash) {
+            visit_count = entry.visit_count;
+            total_action = entry.total_action;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::Clear()
+{
+    ++m_generation;
+}
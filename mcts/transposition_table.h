@@ -0,0 +1,66 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Visit statistics shared by all tree nodes of the same position, keyed by zobrist hash.
+// Entries are split into shards with a mutex each, and each hash probes a few slots of its shard.
+// When all probed slots are taken, the entry with least visits is replaced.
+class TranspositionTable
+{
+ public:
+    TranspositionTable(int64_t max_memory_bytes, int num_shards);
+
+    void Update(uint64_t hash, int64_t action);
+    bool Find(uint64_t hash, int &visit_count, int64_t &total_action);
+    void Clear();
+
+    int64_t Capacity() const { return (int64_t)m_num_shards * m_shard_size; }
+    int64_t MemoryBytes() const { return Capacity() * sizeof(Entry); }
+
+    static const int k_probe_len = 4;
+
+ private:
+    struct Entry
+    {
+        uint64_t hash;
+        uint32_t generation; // entries of old generations are treated as empty
+        int32_t visit_count;
+        int64_t total_action;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+    };
+
+    Shard &GetShard(uint64_t hash) { return m_shards[hash % m_num_shards]; }
+    size_t GetSlot(uint64_t hash) const { return hash / m_num_shards % m_shard_size; }
+
+ private:
+    int m_num_shards;
+    size_t m_shard_size;
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<uint32_t> m_generation;
+};
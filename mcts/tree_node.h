@@ -0,0 +1,159 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+const int64_t k_action_value_base = 1 << 16;
+const int k_unexpanded = 0;
+const int k_expanding = 1;
+const int k_expanded = 2;
+
+// IEEE 754 half precision, round to nearest even
+inline uint16_t FloatToHalf(float f)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(f, 0);
+#else
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7fffffff;
+    if (abs >= 0x7f800000) { // inf or nan
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    }
+    if (abs >= 0x477ff000) { // rounds to inf
+        return sign | 0x7c00;
+    }
+    if (abs < 0x38800000) { // subnormal
+        if (abs <= 0x33000000) {
+            return sign;
+        }
+        int shift = 126 - (abs >> 23);
+        uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1))) ++h;
+        return sign | h;
+    }
+    uint32_t h = (abs >> 13) - ((127 - 15) << 10);
+    uint32_t rem = abs & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h;
+    return sign | h;
+#endif
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0x1f) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else if (exp != 0) {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    } else if (mant != 0) { // subnormal
+        float f = mant * (1.0f / (1 << 24));
+        memcpy(&x, &f, sizeof(x));
+        x |= sign;
+    } else {
+        x = sign;
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+#endif
+}
+
+// 32 bytes, two nodes per cache line.
+// Nodes live in TreeNodeArena and refer to each other by arena index, 0 means null.
+struct TreeNode
+{
+    std::atomic<uint64_t> count;       // visit_count << 32 | virtual_loss_count
+    std::atomic<int64_t> total_action;
+    std::atomic<uint32_t> fa;
+    std::atomic<uint32_t> ch;          // child nodes must allocate contiguously
+    std::atomic<uint16_t> state;       // padded_flag | lazy_flag | expand_state << 12 | ch_len
+    int16_t move;
+    std::atomic<uint16_t> prior_prob;  // fp16
+    std::atomic<uint16_t> value;       // fp16
+
+    static const uint64_t k_visit_unit = 1ULL << 32;
+    static const int k_ch_len_mask = (1 << 12) - 1;
+    static const int k_expand_state_shift = 12;
+    static const int k_expand_state_mask = 3;
+    static const int k_lazy_flag = 1 << 14; // ch refers to a block of TreeEdge instead of TreeNode
+    static const int k_padded_flag = 1 << 15; // each child has a cache line of its own, see TreeNodeArena::AllocatePadded
+
+    // virtual loss is signed, root's one could be -1
+    static int VirtualLossCount(uint64_t count) { return (int32_t)(uint32_t)count; }
+    static int VisitCount(uint64_t count) { return (count - (int64_t)VirtualLossCount(count)) >> 32; }
+
+    int VisitCount() const { return VisitCount(count); }
+    int VirtualLossCount() const { return VirtualLossCount(count); }
+    void AddVirtualLoss() { count.fetch_add(1); }
+    void UndoVirtualLoss() { count.fetch_sub(1); }
+    void AddVisit() { count.fetch_add(k_visit_unit - 1); } // also undo virtual loss of this visit
+
+    int ChLen() const { return state & k_ch_len_mask; }
+    int ExpandState() const { return (state >> k_expand_state_shift) & k_expand_state_mask; }
+    bool IsLazy() const { return state & k_lazy_flag; }
+    bool IsPadded() const { return state & k_padded_flag; }
+    int ChStride() const { return IsPadded() ? 2 : 1; }
+    void SetExpandState(int expand_state, int ch_len = 0, int flags = 0)
+    {
+        state = flags | expand_state << k_expand_state_shift | ch_len;
+    }
+    bool TrySetExpanding()
+    {
+        uint16_t expect = k_unexpanded << k_expand_state_shift;
+        return state.compare_exchange_strong(expect, k_expanding << k_expand_state_shift);
+    }
+
+    float PriorProb() const { return HalfToFloat(prior_prob); }
+    void SetPriorProb(float p) { prior_prob = FloatToHalf(p); }
+    float Value() const { return HalfToFloat(value); }
+    void SetValue(float v) { value = FloatToHalf(v); }
+};
+
+static_assert(sizeof(TreeNode) == 32, "TreeNode should be 32 bytes");
+
+// Child of a lazily expanded node, edges are sorted by prior_prob descending,
+// and child node is created when the edge is selected at first time.
+// Edges with child form a prefix of the edge block.
+struct TreeEdge
+{
+    int16_t move;
+    uint16_t prior_prob;               // fp16
+    std::atomic<uint32_t> child;       // 0 before created
+
+    float PriorProb() const { return HalfToFloat(prior_prob); }
+};
+
+static_assert(sizeof(TreeEdge) == 8, "TreeEdge should be 8 bytes");
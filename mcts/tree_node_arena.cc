@@ -0,0 +1,200 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tree_node_arena.h"
+
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+
+#include <glog/logging.h>
+
+std::atomic<uint64_t> TreeNodeArena::g_next_arena_id(1);
+thread_local TreeNodeArena::LocalRegion TreeNodeArena::g_local_region = {0, 0, 0};
+
+namespace {
+
+// live arenas by id, for threads giving back regions of arenas they no longer allocate from
+std::mutex g_arenas_mutex;
+std::unordered_map<uint64_t, TreeNodeArena *> g_arenas;
+
+} // namespace
+
+TreeNodeArena::TreeNodeArena()
+    : m_id(g_next_arena_id++),
+      m_chunk_table(new TreeNode*[k_max_chunks]()),
+      m_chunk_cur(0),
+      m_chunk_end(0),
+      m_num_reserved_nodes(0)
+{
+    for (auto &free_list: m_free_lists) {
+        free_list.head = 0;
+    }
+    for (auto &free_list: m_padded_free_lists) {
+        free_list.head = 0;
+    }
+    std::lock_guard<std::mutex> lock(g_arenas_mutex);
+    g_arenas[m_id] = this;
+}
+
+TreeNodeArena::~TreeNodeArena()
+{
+    std::lock_guard<std::mutex> lock(g_arenas_mutex);
+    g_arenas.erase(m_id);
+}
+
+void TreeNodeArena::LocalRegion::Release()
+{
+    if (cur != end) {
+        // the lock keeps the arena from being destroyed meanwhile
+        std::lock_guard<std::mutex> lock(g_arenas_mutex);
+        auto it = g_arenas.find(arena_id);
+        if (it != g_arenas.end()) {
+            it->second->PushFreeRange(cur, end - cur);
+        }
+    }
+    arena_id = 0;
+    cur = end = 0;
+}
+
+uint32_t TreeNodeArena::Allocate(int n)
+{
+    CHECK(n > 0 && n <= k_max_block_size) << "TreeNodeArena: invalid block size " << n;
+
+    uint32_t block = PopFreeList(m_free_lists[n], n);
+    if (block == 0) {
+        block = BumpAllocate(n, false);
+    }
+    m_num_allocated_nodes.Add(n);
+    return block;
+}
+
+void TreeNodeArena::Free(uint32_t block, int n)
+{
+    if (block == 0 || n == 0) {
+        return;
+    }
+    CHECK(n > 0 && n <= k_max_block_size) << "TreeNodeArena: invalid block size " << n;
+    m_num_allocated_nodes.Sub(n);
+    PushFreeList(m_free_lists[n], block, n);
+}
+
+uint32_t TreeNodeArena::AllocatePadded(int n)
+{
+    CHECK(n > 0 && n <= k_max_block_size) << "TreeNodeArena: invalid block size " << n;
+
+    // padded blocks have their own free lists, as a block of the same size in m_free_lists may not be aligned
+    uint32_t block = PopFreeList(m_padded_free_lists[n], 2 * n);
+    if (block == 0) {
+        block = BumpAllocate(2 * n, true);
+    }
+    m_num_allocated_nodes.Add(2 * n);
+    return block;
+}
+
+void TreeNodeArena::FreePadded(uint32_t block, int n)
+{
+    if (block == 0 || n == 0) {
+        return;
+    }
+    CHECK(n > 0 && n <= k_max_block_size) << "TreeNodeArena: invalid block size " << n;
+    m_num_allocated_nodes.Sub(2 * n);
+    PushFreeList(m_padded_free_lists[n], block, 2 * n);
+}
+
+uint32_t TreeNodeArena::PopFreeList(FreeList &free_list, int n)
+{
+    if (free_list.head.load(std::memory_order_relaxed) == 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(free_list.mutex);
+    uint32_t block = free_list.head;
+    if (block != 0) {
+        free_list.head = Get(block)->fa.load();
+        m_num_free_nodes.Sub(n);
+    }
+    return block;
+}
+
+void TreeNodeArena::PushFreeList(FreeList &free_list, uint32_t block, int n)
+{
+    std::lock_guard<std::mutex> lock(free_list.mutex);
+    Get(block)->fa = free_list.head.load(); // reuse fa as free list link
+    free_list.head = block;
+    m_num_free_nodes.Add(n);
+}
+
+void TreeNodeArena::PushFreeRange(uint32_t block, int n)
+{
+    while (n > 0) {
+        int len = std::min(n, k_max_block_size);
+        PushFreeList(m_free_lists[len], block, len);
+        block += len;
+        n -= len;
+    }
+}
+
+uint32_t TreeNodeArena::BumpAllocate(int n, bool line_aligned)
+{
+    LocalRegion &region = g_local_region;
+    if (line_aligned && region.arena_id == m_id && region.cur != region.end && (region.cur & 1)) {
+        PushFreeRange(region.cur++, 1);
+    }
+    if (region.arena_id != m_id || region.end - region.cur < (uint32_t)n) {
+        if (region.arena_id == m_id && region.cur != region.end) {
+            PushFreeRange(region.cur, region.end - region.cur);
+        } else if (region.arena_id != m_id) {
+            region.Release();
+        }
+        region.arena_id = m_id;
+        region.cur = NewRegion(region.end);
+        if (line_aligned && (region.cur & 1)) {
+            PushFreeRange(region.cur++, 1);
+        }
+    }
+    uint32_t block = region.cur;
+    region.cur += n;
+    return block;
+}
+
+uint32_t TreeNodeArena::NewRegion(uint32_t &end)
+{
+    std::lock_guard<std::mutex> lock(m_chunks_mutex);
+    if (m_chunk_cur == m_chunk_end) {
+        size_t chunk_id = m_chunks.size();
+        CHECK_LT(chunk_id, (size_t)k_max_chunks) << "TreeNodeArena: index space exhausted";
+        m_chunks.emplace_back(new char[k_chunk_size * sizeof(TreeNode) + k_cache_line_size]);
+        uintptr_t addr = reinterpret_cast<uintptr_t>(m_chunks.back().get());
+        addr = (addr + k_cache_line_size - 1) & ~(uintptr_t)(k_cache_line_size - 1);
+        // TreeNode is trivial, constructing costs nothing, all fields are set by InitNode before use
+        TreeNode *nodes = reinterpret_cast<TreeNode*>(addr);
+        for (int i = 0; i < k_chunk_size; ++i) {
+            new (&nodes[i]) TreeNode;
+        }
+        m_chunk_table[chunk_id] = nodes;
+        m_chunk_cur = chunk_id << k_chunk_bits;
+        m_chunk_end = m_chunk_cur + k_chunk_size; // wraps to 0 for the last chunk
+        if (chunk_id == 0) {
+            m_chunk_cur = 1; // index 0 is null
+        }
+        m_num_reserved_nodes += k_chunk_size;
+    }
+    uint32_t region = m_chunk_cur;
+    m_chunk_cur += std::min<uint32_t>(k_region_size, m_chunk_end - m_chunk_cur);
+    end = m_chunk_cur;
+    return region;
+}
@@ -0,0 +1,116 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/go_comm.h"
+#include "common/sharded_counter.h"
+
+#include "tree_node.h"
+
+// Allocator for contiguous blocks of TreeNode.
+// Memory is reserved in large chunks, each thread bump-allocates from its own
+// region of a chunk, and freed blocks are kept in free lists by block length.
+// The rest of a thread's region goes to free lists when the thread moves to another arena or exits.
+// Chunks are only returned to system when the whole arena is destroyed.
+// Nodes are addressed by 32-bit index (chunk << k_chunk_bits | offset), index 0 is never allocated.
+// Chunks are cache line aligned, so a node with even index starts a cache line.
+class TreeNodeArena
+{
+ public:
+    TreeNodeArena();
+    ~TreeNodeArena();
+
+    uint32_t Allocate(int n);
+    void Free(uint32_t block, int n);
+
+    // n nodes with stride 2 starting at a cache line, i-th node is block + 2 * i,
+    // so that writes to one node never invalidate the cache line of another
+    uint32_t AllocatePadded(int n);
+    void FreePadded(uint32_t block, int n);
+
+    TreeNode *Get(uint32_t index) const
+    {
+        return index ? m_chunk_table[index >> k_chunk_bits] + (index & (k_chunk_size - 1)) : nullptr;
+    }
+
+    // edges are stored in node slots, k_edges_per_node per slot
+    TreeEdge *GetEdges(uint32_t index) const { return reinterpret_cast<TreeEdge*>(Get(index)); }
+    static int EdgeBlockSize(int num_edges) { return (num_edges + k_edges_per_node - 1) / k_edges_per_node; }
+
+    // counters are sharded by thread, reading them costs a scan over all shards
+    int64_t NumAllocatedNodes() const { return m_num_allocated_nodes.Sum(); }
+    int64_t NumFreeNodes() const { return m_num_free_nodes.Sum(); }
+    int64_t NumReservedNodes() const { return m_num_reserved_nodes; }
+    int64_t ReservedBytes() const { return m_num_reserved_nodes * (int64_t)sizeof(TreeNode); }
+
+    static const int k_max_block_size = GoComm::GOBOARD_SIZE + 1;
+    static const int k_region_size = 1 << 12;
+    static const int k_chunk_bits = 16;
+    static const int k_chunk_size = 1 << k_chunk_bits;
+    static const int k_max_chunks = 1 << (32 - k_chunk_bits);
+    static const int k_edges_per_node = sizeof(TreeNode) / sizeof(TreeEdge);
+    static const int k_cache_line_size = 64;
+
+ private:
+    struct FreeList
+    {
+        std::mutex mutex;
+        std::atomic<uint32_t> head;
+    };
+
+    uint32_t PopFreeList(FreeList &free_list, int n);
+    void PushFreeList(FreeList &free_list, uint32_t block, int n);
+    void PushFreeRange(uint32_t block, int n);
+    uint32_t BumpAllocate(int n, bool line_aligned);
+    uint32_t NewRegion(uint32_t &end);
+
+    // bump region owned by current thread, valid only for arena with same id
+    struct LocalRegion
+    {
+        uint64_t arena_id;
+        uint32_t cur;
+        uint32_t end;
+
+        void Release(); // rest of region to free lists of its arena, if the arena is still alive
+        ~LocalRegion() { Release(); }
+    };
+
+ private:
+    uint64_t m_id;
+
+    std::mutex m_chunks_mutex;
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    std::unique_ptr<TreeNode*[]> m_chunk_table;
+    uint32_t m_chunk_cur;
+    uint32_t m_chunk_end;
+
+    FreeList m_free_lists[k_max_block_size + 1];
+    FreeList m_padded_free_lists[k_max_block_size + 1];
+
+    ShardedCounter m_num_allocated_nodes;
+    ShardedCounter m_num_free_nodes;
+    std::atomic<int64_t> m_num_reserved_nodes;
+
+    static std::atomic<uint64_t> g_next_arena_id;
+    static thread_local LocalRegion g_local_region;
+};
@@ -69,6 +69,8 @@ TrtZeroModel::~TrtZeroModel()
 
 int TrtZeroModel::Init(const ModelConfig &model_config)
 {
+    InitBoardSize(model_config);
+
     cudaSetDevice(m_gpu);
 
     fs::path train_dir = model_config.train_dir();
@@ -132,17 +134,41 @@ int TrtZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
         return ERR_INVALID_INPUT;
     }
 
-    std::vector<float> inputs_flat(batch_size * INPUT_DIM);
+    int input_dim = InputDim();
+    std::vector<float> inputs_flat(batch_size * input_dim);
     for (int i = 0; i < batch_size; ++i) {
-        if (inputs[i].size() != INPUT_DIM) {
-            LOG(ERROR) << "Error input dim not match, need " << INPUT_DIM << ", got " << inputs[i].size();
+        if ((int)inputs[i].size() != input_dim) {
+            LOG(ERROR) << "Error input dim not match, need " << input_dim << ", got " << inputs[i].size();
             return ERR_INVALID_INPUT;
         }
-        for (int j = 0; j < INPUT_DIM; ++j) {
-            inputs_flat[i * INPUT_DIM + j] = inputs[i][j];
+        for (int j = 0; j < input_dim; ++j) {
+            inputs_flat[i * input_dim + j] = inputs[i][j];
         }
     }
 
+    return Execute(inputs_flat, policy, value);
+}
+
+int TrtZeroModel::Forward(const std::vector<const PackedFeatures *> &inputs,
+                          std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    int batch_size = inputs.size();
+    if (batch_size == 0) {
+        LOG(ERROR) << "Error batch size can not be 0.";
+        return ERR_INVALID_INPUT;
+    }
+
+    std::vector<float> inputs_flat(batch_size * InputDim());
+    PackedFeatures::Unpack(inputs.data(), batch_size, BoardSize(), inputs_flat.data());
+
+    return Execute(inputs_flat, policy, value);
+}
+
+int TrtZeroModel::Execute(const std::vector<float> &inputs_flat,
+                          std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    int batch_size = inputs_flat.size() / InputDim();
+    int output_dim = OutputDim();
     int ret = cudaMemcpy(m_cuda_buf[0], inputs_flat.data(), inputs_flat.size() * sizeof(float), cudaMemcpyHostToDevice);
     if (ret != 0) {
         LOG(ERROR) << "cuda memcpy err " << ret;
@@ -151,7 +177,7 @@ int TrtZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
 
     m_context->execute(batch_size, m_cuda_buf.data());
 
-    std::vector<float> policy_flat(batch_size * OUTPUT_DIM);
+    std::vector<float> policy_flat(batch_size * output_dim);
     ret = cudaMemcpy(policy_flat.data(), m_cuda_buf[1], policy_flat.size() * sizeof(float), cudaMemcpyDeviceToHost);
     if (ret != 0) {
         LOG(ERROR) << "cuda memcpy err " << ret;
@@ -159,9 +185,9 @@ int TrtZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
     }
     policy.resize(batch_size);
     for (int i = 0; i < batch_size; ++i) {
-        policy[i].resize(OUTPUT_DIM);
-        for (int j = 0; j < OUTPUT_DIM; ++j) {
-            policy[i][j] = policy_flat[i * OUTPUT_DIM + j];
+        policy[i].resize(output_dim);
+        for (int j = 0; j < output_dim; ++j) {
+            policy[i][j] = policy_flat[i * output_dim + j];
         }
     }
 
@@ -211,6 +237,13 @@ int TrtZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
     return 0;
 }
 
+int TrtZeroModel::Forward(const std::vector<const PackedFeatures *> &inputs,
+                          std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    LOG(FATAL) << "TensorRT is not enable!";
+    return 0;
+}
+
 int TrtZeroModel::GetGlobalStep(int &global_step)
 {
     LOG(FATAL) << "TensorRT is not enable!";
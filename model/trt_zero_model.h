@@ -41,8 +41,17 @@ class TrtZeroModel final : public ZeroModelBase
     int Forward(const std::vector<std::vector<bool>> &inputs,
                 std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
 
+    int Forward(const std::vector<const PackedFeatures *> &inputs,
+                std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
+
+    using ZeroModelBase::Forward;
+
     int GetGlobalStep(int &global_step) override;
 
+ private:
+    int Execute(const std::vector<float> &inputs_flat,
+                std::vector<std::vector<float>> &policy, std::vector<float> &value);
+
  private:
     nvinfer1::ICudaEngine *m_engine;
     nvinfer1::IRuntime *m_runtime;
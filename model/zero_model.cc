@@ -50,6 +50,8 @@ ZeroModel::~ZeroModel()
 
 int ZeroModel::Init(const ModelConfig &model_config)
 {
+    InitBoardSize(model_config);
+
     fs::path train_dir = model_config.train_dir();
 
     fs::path meta_graph_path = model_config.meta_graph_path();
@@ -118,7 +120,7 @@ int ZeroModel::Init(const ModelConfig &model_config)
     }
     LOG(INFO) << "Load checkpoint succ";
 
-    std::vector<std::vector<bool>> inputs(1, std::vector<bool>(INPUT_DIM, false));
+    std::vector<std::vector<bool>> inputs(1, std::vector<bool>(InputDim(), false));
     std::vector<std::vector<float>> policy;
     std::vector<float> value;
     Forward(inputs, policy, value);
@@ -135,19 +137,41 @@ int ZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
         return ERR_INVALID_INPUT;
     }
 
-    tf::Tensor feature_tensor(tf::DT_BOOL, tf::TensorShape({batch_size, INPUT_DIM}));
+    int input_dim = InputDim();
+    tf::Tensor feature_tensor(tf::DT_BOOL, tf::TensorShape({batch_size, input_dim}));
     auto matrix = feature_tensor.matrix<bool>();
     for (int i = 0; i < batch_size; ++i) {
-        if (inputs[i].size() != INPUT_DIM) {
-            LOG(ERROR) << "Error input dim not match, need " << INPUT_DIM << ", got " << inputs[i].size();
+        if ((int)inputs[i].size() != input_dim) {
+            LOG(ERROR) << "Error input dim not match, need " << input_dim << ", got " << inputs[i].size();
             return ERR_INVALID_INPUT;
         }
-        for (int j = 0; j < INPUT_DIM; ++j) {
+        for (int j = 0; j < input_dim; ++j) {
             matrix(i, j) = inputs[i][j];
         }
     }
 
+    return RunSession(feature_tensor, policy, value);
+}
+
+int ZeroModel::Forward(const std::vector<const PackedFeatures *> &inputs,
+                       std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    int batch_size = inputs.size();
+    if (batch_size == 0) {
+        LOG(ERROR) << "Error batch size can not be 0.";
+        return ERR_INVALID_INPUT;
+    }
+
+    tf::Tensor feature_tensor(tf::DT_BOOL, tf::TensorShape({batch_size, InputDim()}));
+    PackedFeatures::Unpack(inputs.data(), batch_size, BoardSize(), feature_tensor.flat<bool>().data());
 
+    return RunSession(feature_tensor, policy, value);
+}
+
+int ZeroModel::RunSession(const tensorflow::Tensor &feature_tensor,
+                          std::vector<std::vector<float>> &policy, std::vector<float> &value)
+{
+    int batch_size = feature_tensor.dim_size(0);
     std::vector<std::pair<std::string, tf::Tensor>> network_inputs = {{input_tensor_name, feature_tensor}};
     std::vector<std::string> fetch_outputs = {policy_tensor_name, value_tensor_name};
     std::vector<tf::Tensor> network_outputs;
@@ -162,8 +186,8 @@ int ZeroModel::Forward(const std::vector<std::vector<bool>> &inputs,
     policy.resize(batch_size);
     value.resize(batch_size);
     for (int i = 0; i < batch_size; ++i) {
-        policy[i].resize(OUTPUT_DIM);
-        for (int j = 0; j < OUTPUT_DIM; ++j) {
+        policy[i].resize(OutputDim());
+        for (int j = 0; j < OutputDim(); ++j) {
             policy[i][j] = policy_tensor(i, j);
         }
         value[i] = -value_tensor(i);
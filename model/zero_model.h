@@ -22,7 +22,7 @@
 #include "model/zero_model_base.h"
 #include "model/model_config.pb.h"
 
-namespace tensorflow { class Session; }
+namespace tensorflow { class Session; class Tensor; }
 
 class ZeroModel final : public ZeroModelBase
 {
@@ -37,10 +37,19 @@ class ZeroModel final : public ZeroModelBase
     int Forward(const std::vector<std::vector<bool>> &inputs,
                 std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
 
+    int Forward(const std::vector<const PackedFeatures *> &inputs,
+                std::vector<std::vector<float>> &policy, std::vector<float> &value) override;
+
+    using ZeroModelBase::Forward;
+
     int GetGlobalStep(int &global_step) override;
 
     static void SetMKLEnv(const ModelConfig &model_config);
 
+ private:
+    int RunSession(const tensorflow::Tensor &feature_tensor,
+                   std::vector<std::vector<float>> &policy, std::vector<float> &value);
+
  private:
     std::unique_ptr<tensorflow::Session> m_session;
     int m_gpu;
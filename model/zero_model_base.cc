@@ -0,0 +1,121 @@
+/*
+ * Tencent is pleased to support the open source community by making PhoenixGo available.
+ * 
+ * Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "zero_model_base.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+namespace {
+
+// bit k of mask is plane k of point id
+inline uint32_t GatherPoint(const PackedFeatures &features, int id)
+{
+    int w = id >> 6, b = id & 63;
+    uint32_t mask = 0;
+    for (int k = 0; k < PackedFeatures::NUM_PLANES; ++k) {
+        mask |= (uint32_t)(features.planes[k][w] >> b & 1) << k;
+    }
+    return mask;
+}
+
+inline void ExpandPoint(uint32_t mask, float *dst)
+{
+    int k = 0;
+#if HAVE_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i v = _mm_set1_epi32(mask);
+    for (; k + 4 <= PackedFeatures::NUM_PLANES; k += 4) {
+        __m128i bits = _mm_set_epi32(8 << k, 4 << k, 2 << k, 1 << k);
+        __m128i on = _mm_cmpeq_epi32(_mm_and_si128(v, bits), bits);
+        _mm_storeu_ps(dst + k, _mm_and_ps(_mm_castsi128_ps(on), one));
+    }
+#endif
+    for (; k < PackedFeatures::NUM_PLANES; ++k) {
+        dst[k] = mask >> k & 1;
+    }
+}
+
+inline void ExpandPoint(uint32_t mask, bool *dst)
+{
+    int k = 0;
+#if HAVE_SSE2
+    // bytes 0-7 hold bits 0-7 of mask, bytes 8-15 hold bits 8-15, then pick bit i % 8 of byte i
+    const __m128i bits = _mm_set1_epi64x(0x8040201008040201LL);
+    __m128i v = _mm_set_epi64x((mask >> 8 & 0xff) * 0x0101010101010101ULL, (mask & 0xff) * 0x0101010101010101ULL);
+    __m128i on = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+    _mm_storeu_si128((__m128i *)dst, _mm_and_si128(on, _mm_set1_epi8(1)));
+    k = 16;
+#endif
+    for (; k < PackedFeatures::NUM_PLANES; ++k) {
+        dst[k] = mask >> k & 1;
+    }
+}
+
+template<class T>
+void UnpackBatch(const PackedFeatures *const *inputs, int batch_size, int board_size, T *dst)
+{
+    for (int i = 0; i < batch_size; ++i) {
+        for (int id = 0; id < board_size * board_size; ++id) {
+            ExpandPoint(GatherPoint(*inputs[i], id), dst);
+            dst += PackedFeatures::NUM_PLANES;
+        }
+    }
+}
+
+} // namespace
+
+void PackedFeatures::Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size, float *dst)
+{
+    UnpackBatch(inputs, batch_size, board_size, dst);
+}
+
+void PackedFeatures::Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size, bool *dst)
+{
+    static_assert(sizeof(bool) == 1, "bool is expected to be one byte");
+    UnpackBatch(inputs, batch_size, board_size, dst);
+}
+
+void PackedFeatures::Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size,
+                            std::vector<std::vector<bool>> &dst)
+{
+    dst.resize(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+        dst[i].assign(board_size * board_size * NUM_PLANES, false);
+        auto bit = dst[i].begin();
+        for (int id = 0; id < board_size * board_size; ++id) {
+            uint32_t mask = GatherPoint(*inputs[i], id);
+            for (int k = 0; k < NUM_PLANES; ++k) {
+                *bit++ = mask >> k & 1;
+            }
+        }
+    }
+}
+
+void PackedFeatures::UnpackBits(int board_size, std::string *dst) const
+{
+    dst->assign((board_size * board_size * NUM_PLANES + 7) / 8, 0);
+    char *bytes = &(*dst)[0];
+    for (int id = 0, bit = 0; id < board_size * board_size; ++id, bit += NUM_PLANES) {
+        // 17 bits of a point span at most 3 bytes
+        for (uint32_t v = GatherPoint(*this, id) << (bit & 7), i = bit >> 3; v; v >>= 8, ++i) {
+            bytes[i] |= v & 0xff;
+        }
+    }
+}
@@ -17,6 +17,8 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <functional>
 
@@ -24,6 +26,29 @@
 
 #include "model/model_config.pb.h"
 
+// Model input of one position, 17 planes of up to 19 * 19 bits. Bit of point id in plane k is
+// planes[k][id >> 6] >> (id & 63) & 1, it is element id * 17 + k of the unpacked [N * N * 17] input
+// on board of border size N, bits past N * N are 0.
+struct PackedFeatures
+{
+    enum {
+        NUM_PLANES = 17,
+        NUM_POINTS = 19 * 19,
+        NUM_WORDS  = (NUM_POINTS + 63) / 64,
+    };
+
+    uint64_t planes[NUM_PLANES][NUM_WORDS];
+
+    // unpack a batch to [batch, N * N * 17], inputs[i] is the i-th position
+    static void Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size, float *dst);
+    static void Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size, bool *dst);
+    static void Unpack(const PackedFeatures *const *inputs, int batch_size, int board_size,
+                       std::vector<std::vector<bool>> &dst);
+
+    // unpacked input as bit string of dist ForwardReq.inputs, element i is bit i % 8 of byte i / 8
+    void UnpackBits(int board_size, std::string *dst) const;
+};
+
 class ZeroModelBase
 {
  public:
@@ -44,14 +69,47 @@ class ZeroModelBase
         callback(ret, std::move(policy), std::move(value));
     }
 
+    // same as above with packed inputs, in-tree backends override it to unpack only once, or not at all.
+    // Positions are passed by pointer so callers need not gather them, backends unpack them straight from there.
+    // They are read before Forward returns, callers may reuse them for the next batch even if callback is pending.
+    virtual int Forward(const std::vector<const PackedFeatures *> &inputs,
+                        std::vector<std::vector<float>> &policy, std::vector<float> &value)
+    {
+        return Forward(UnpackInputs(inputs), policy, value);
+    }
+
+    virtual void Forward(const std::vector<const PackedFeatures *> &inputs, callback_t callback)
+    {
+        std::vector<std::vector<float>> policy;
+        std::vector<float> value;
+        int ret = Forward(inputs, policy, value);
+        callback(ret, std::move(policy), std::move(value));
+    }
+
     virtual int GetGlobalStep(int &global_step) = 0;
 
     virtual int RpcQueueSize() { return 0; }
 
     virtual void Wait() {}
 
-    enum {
-        INPUT_DIM  = 19 * 19 * 17,
-        OUTPUT_DIM = 19 * 19 + 1,
-    };
+    // inputs and outputs are for board of ModelConfig.board_size, known after Init
+    int BoardSize() const { return m_board_size; }
+    int InputDim() const { return m_board_size * m_board_size * PackedFeatures::NUM_PLANES; }
+    int OutputDim() const { return m_board_size * m_board_size + 1; }
+
+ protected:
+    void InitBoardSize(const ModelConfig &model_config)
+    {
+        m_board_size = model_config.board_size() > 0 ? model_config.board_size() : 19;
+    }
+
+    std::vector<std::vector<bool>> UnpackInputs(const std::vector<const PackedFeatures *> &inputs) const
+    {
+        std::vector<std::vector<bool>> unpacked;
+        PackedFeatures::Unpack(inputs.data(), inputs.size(), m_board_size, unpacked);
+        return unpacked;
+    }
+
+ private:
+    int m_board_size = 19;
 };